@@ -0,0 +1,104 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <vector>
+
+/**
+ Low-passes and decimates a stereo pair for the analyzer's low band.
+
+ The same FFT size on a signal decimated by Factor has Factor times finer bins, which is
+ what the log frequency axis needs below a few hundred Hz. The anti-aliasing filter is an
+ 8th order Butterworth at 60% of the decimated Nyquist, so only bins below getCrossover()
+ are clean enough to display, and everything that folds back onto them is at least 60 dB down.
+ */
+class AnalyzerDecimator
+{
+public:
+    static constexpr int Factor = 8;
+
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        phase = 0;
+
+        auto coefficients = juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(getCutoff(), sampleRate, 8);
+
+        for (auto& filters : channelFilters)
+        {
+            filters.clear();
+            filters.reserve((size_t) coefficients.size());
+
+            for (auto* c : coefficients)
+            {
+                filters.emplace_back(c);
+                filters.back().reset();
+            }
+        }
+    }
+
+    bool isPrepared() const { return sampleRate > 0.0; }
+
+    double getOutputSampleRate() const { return sampleRate / Factor; }
+    /** Highest frequency the low band should be used for */
+    float getCrossover() const { return (float) (sampleRate / Factor * 0.15); }
+
+    /**
+     Filters numSamples of both channels and appends the decimated output to the end of
+     'history', shifting out the oldest samples. history must have two channels.
+     */
+    void process(const float* left, const float* right, int numSamples, juce::AudioBuffer<float>& history)
+    {
+        jassert(isPrepared() && history.getNumChannels() >= 2);
+
+        scratch.resize((size_t) (numSamples / Factor + 1) * 2);
+        auto* leftOut = scratch.data();
+        auto* rightOut = scratch.data() + scratch.size() / 2;
+        int numOut = 0;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto l = left[i];
+            auto r = right[i];
+
+            for (auto& f : channelFilters[0])
+                l = f.processSample(l);
+
+            for (auto& f : channelFilters[1])
+                r = f.processSample(r);
+
+            if (++phase == Factor)
+            {
+                phase = 0;
+                leftOut[numOut] = l;
+                rightOut[numOut] = r;
+                ++numOut;
+            }
+        }
+
+        auto size = juce::jmin(numOut, history.getNumSamples());
+        auto keep = history.getNumSamples() - size;
+
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            juce::FloatVectorOperations::copy(history.getWritePointer(ch, 0), history.getReadPointer(ch, size), keep);
+            juce::FloatVectorOperations::copy(history.getWritePointer(ch, keep), (ch == 0 ? leftOut : rightOut) + numOut - size, size);
+        }
+    }
+
+    size_t getNumBytes() const
+    {
+        return (channelFilters[0].capacity() + channelFilters[1].capacity()) * sizeof(juce::dsp::IIR::Filter<float>)
+             + scratch.capacity() * sizeof(float);
+    }
+
+private:
+    float getCutoff() const { return (float) (sampleRate / Factor * 0.5 * 0.6); }
+
+    double sampleRate = 0.0;
+    int phase = 0;
+
+    std::array<std::vector<juce::dsp::IIR::Filter<float>>, 2> channelFilters;
+    std::vector<float> scratch;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+
+/**
+ Loudness compensation computed from the EQ's magnitude response rather than metered.
+
+ The response is sampled at NumPoints log-spaced frequencies between 20 Hz and 20 kHz.
+ Pink noise has equal power per octave, so on a log axis every point carries the same
+ weight before the K-weighting of BS.1770 is applied on top. The compensation is the
+ inverse of the weighted RMS gain, so pink programme material comes out at the same
+ loudness with the EQ in or out. There is no detector, no latency, and the weighting
+ is only evaluated again when the response changes.
+
+ The response is evaluated straight from the chain's biquad sections, with the cosine terms
+ of every point worked out in prepare, so an update costs a few multiply-adds per section
+ and point and is safe to run on the audio thread once per block.
+ */
+class AutoGain
+{
+public:
+    static constexpr int NumPoints = 64;
+    static constexpr float MaxCompensationDecibels = 24.f;
+
+    /** Not realtime safe, the K-weighting filters are designed here */
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+
+        /** BS.1770 pre-filter: a +4 dB high shelf around 1.5 kHz and the RLB high-pass at 38 Hz */
+        auto shelf = juce::dsp::IIR::Coefficients<float>::makeHighShelf(sampleRate, 1500.f, 0.71f, juce::Decibels::decibelsToGain(4.f));
+        auto highPass = juce::dsp::IIR::Coefficients<float>::makeHighPass(sampleRate, 38.f, 0.5f);
+
+        const auto maxFrequency = sampleRate * 0.45;
+        weightSum = 0.f;
+
+        for (int i = 0; i < NumPoints; ++i)
+        {
+            auto frequency = juce::mapToLog10((double) i / (double) (NumPoints - 1), 20.0, 20000.0);
+            auto& point = points[(size_t) i];
+
+            /** Points past Nyquist carry no weight, the programme has nothing there */
+            point.frequency = juce::jmin(frequency, maxFrequency);
+            
+            const auto omega = juce::MathConstants<double>::twoPi * point.frequency / sampleRate;
+            point.cosOmega = std::cos(omega);
+            point.cos2Omega = std::cos(2.0 * omega);
+
+            if (frequency > maxFrequency)
+            {
+                point.weight = 0.f;
+                continue;
+            }
+
+            auto kWeighting = shelf->getMagnitudeForFrequency(frequency, sampleRate)
+                            * highPass->getMagnitudeForFrequency(frequency, sampleRate);
+
+            point.weight = (float) (kWeighting * kWeighting);
+            weightSum += point.weight;
+        }
+
+        gain.reset(sampleRate, 0.05);
+        gain.setCurrentAndTargetValue(enabled ? compensation : 1.f);
+    }
+
+    /**
+     Recomputes the compensation from the EQ's active sections, each b0, b1, b2, a1, a2 normalised by a0,
+     as in ChainKernels::SectionCoefficients. Call only when the coefficients changed
+     */
+    void update(const float* const* sections, int numSections)
+    {
+        if (weightSum <= 0.f)
+            return;
+
+        double power = 0.0;
+
+        for (const auto& point : points)
+        {
+            if (point.weight <= 0.f)
+                continue;
+
+            double magnitudeSquared = 1.0;
+
+            for (int i = 0; i < numSections; ++i)
+                magnitudeSquared *= getMagnitudeSquared(sections[i], point);
+
+            power += point.weight * magnitudeSquared;
+        }
+
+        auto gainDecibels = -juce::Decibels::gainToDecibels(std::sqrt(power / weightSum));
+        compensation = juce::Decibels::decibelsToGain(juce::jlimit(-MaxCompensationDecibels, MaxCompensationDecibels, (float) gainDecibels));
+
+        if (enabled)
+            gain.setTargetValue(compensation);
+    }
+
+    /** Ramps to or from the compensation rather than switching */
+    void setEnabled(bool shouldBeEnabled)
+    {
+        if (enabled == shouldBeEnabled)
+            return;
+
+        enabled = shouldBeEnabled;
+        gain.setTargetValue(enabled ? compensation : 1.f);
+    }
+
+    float getCompensationDecibels() const { return juce::Decibels::gainToDecibels(compensation); }
+
+    /** Applies the smoothed gain. Does nothing once it has settled at unity */
+    void process(juce::dsp::AudioBlock<float>& block)
+    {
+        if (! gain.isSmoothing() && gain.getTargetValue() == 1.f)
+            return;
+
+        block.multiplyBy(gain);
+    }
+
+private:
+    struct Point
+    {
+        double frequency = 1000.0;
+        double cosOmega = 1.0, cos2Omega = 1.0;
+        float weight = 0.f;
+    };
+
+    /** |H|^2 of one biquad: |b0 + b1 z^-1 + b2 z^-2|^2 over |1 + a1 z^-1 + a2 z^-2|^2 on the unit circle */
+    static double getMagnitudeSquared(const float* c, const Point& point)
+    {
+        const double b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+
+        const auto numerator = b0 * b0 + b1 * b1 + b2 * b2
+                             + 2.0 * (b0 * b1 + b1 * b2) * point.cosOmega
+                             + 2.0 * b0 * b2 * point.cos2Omega;
+        const auto denominator = 1.0 + a1 * a1 + a2 * a2
+                               + 2.0 * (a1 + a1 * a2) * point.cosOmega
+                               + 2.0 * a2 * point.cos2Omega;
+
+        return numerator / juce::jmax(denominator, 1.0e-30);
+    }
+
+    std::array<Point, NumPoints> points;
+    float weightSum = 0.f;
+    double sampleRate = 44100.0;
+
+    bool enabled = false;
+    float compensation = 1.f;
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> gain;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+
+/**
+ The bilinear designs of juce::dsp::IIR::Coefficients, returned by value.
+
+ Same formulas as makePeakFilter, makeLowPass and makeHighPass, so a section designed here
+ matches the cached designs. Nothing is allocated, so the audio thread can design at any rate.
+ */
+namespace BilinearDesign
+{
+    using Biquad = std::array<float, 5>; // b0, b1, b2, a1, a2 normalised by a0
+
+    /** gain is linear */
+    inline Biquad makePeak(double sampleRate, double frequency, double quality, double gain)
+    {
+        const auto A = std::sqrt(juce::jmax(0.0, gain));
+        const auto omega = juce::MathConstants<double>::twoPi * juce::jmax(frequency, 2.0) / sampleRate;
+        const auto alpha = std::sin(omega) / (quality * 2.0);
+        const auto c2 = -2.0 * std::cos(omega);
+        const auto alphaTimesA = alpha * A;
+        const auto alphaOverA = alpha / A;
+        const auto a0Inverse = 1.0 / (1.0 + alphaOverA);
+
+        return { (float) ((1.0 + alphaTimesA) * a0Inverse),
+                 (float) (c2 * a0Inverse),
+                 (float) ((1.0 - alphaTimesA) * a0Inverse),
+                 (float) (c2 * a0Inverse),
+                 (float) ((1.0 - alphaOverA) * a0Inverse) };
+    }
+
+    inline Biquad makeLowPass(double sampleRate, double frequency, double quality)
+    {
+        const auto n = 1.0 / std::tan(juce::MathConstants<double>::pi * frequency / sampleRate);
+        const auto nSquared = n * n;
+        const auto c1 = 1.0 / (1.0 + n / quality + nSquared);
+
+        return { (float) c1,
+                 (float) (c1 * 2.0),
+                 (float) c1,
+                 (float) (c1 * 2.0 * (1.0 - nSquared)),
+                 (float) (c1 * (1.0 - n / quality + nSquared)) };
+    }
+
+    inline Biquad makeHighPass(double sampleRate, double frequency, double quality)
+    {
+        const auto n = std::tan(juce::MathConstants<double>::pi * frequency / sampleRate);
+        const auto nSquared = n * n;
+        const auto c1 = 1.0 / (1.0 + n / quality + nSquared);
+
+        return { (float) c1,
+                 (float) (c1 * -2.0),
+                 (float) c1,
+                 (float) (c1 * 2.0 * (nSquared - 1.0)),
+                 (float) (c1 * (1.0 - n / quality + nSquared)) };
+    }
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <utility>
+
+/**
+ Fused processing kernels for a mono filter chain.
+
+ Every combination of low cut slope, high cut slope and band bypass gets its own kernel
+ with the active biquad sections fixed at compile time, so the per-sample loop has no
+ bypass checks and a constant section count the compiler can unroll.
+ The kernel is picked once per coefficient update with getKernel().
+
+ Sections are numbered low cut stages 0-3, then the peak, then high cut stages 0-3.
+ */
+namespace ChainKernels
+{
+    constexpr int MaxCutStages = 4;
+    constexpr int PeakSection = MaxCutStages;
+    constexpr int HighCutSection = MaxCutStages + 1;
+    constexpr int NumSections = 2 * MaxCutStages + 1;
+
+    // Transposed direct form II state of every section. Bypassed sections keep theirs
+    struct State
+    {
+        std::array<std::array<float, 2>, NumSections> z {};
+
+        void reset() { z = {}; }
+        void resetSection(int section) { z[(size_t) section] = {}; }
+        
+        /** Resets every section whose state went NaN or infinite. Returns how many there were */
+        int resetNonFiniteSections()
+        {
+            /** Any NaN or infinity makes the sum non-finite, so a healthy state costs one pass and one check */
+            float sum = 0.f;
+            
+            for (const auto& section : z)
+                sum += section[0] + section[1];
+            
+            if (std::isfinite(sum))
+                return 0;
+            
+            int numReset = 0;
+            
+            for (int section = 0; section < NumSections; ++section)
+            {
+                const auto& sectionState = z[(size_t) section];
+                
+                if (! std::isfinite(sectionState[0]) || ! std::isfinite(sectionState[1]))
+                {
+                    resetSection(section);
+                    ++numReset;
+                }
+            }
+            
+            return numReset;
+        }
+    };
+
+    // Normalised b0, b1, b2, a1, a2 of every section, as returned by IIR::Coefficients::getRawCoefficients()
+    using SectionCoefficients = std::array<const float*, NumSections>;
+
+    using Kernel = void (*)(const SectionCoefficients&, State&, float*, int);
+
+    template<int NumLowCut, bool PeakActive, int NumHighCut>
+    void process(const SectionCoefficients& coefficients, State& state, float* samples, int numSamples)
+    {
+        constexpr int NumActive = NumLowCut + (PeakActive ? 1 : 0) + NumHighCut;
+
+        if constexpr (NumActive == 0)
+        {
+            juce::ignoreUnused(coefficients, state, samples, numSamples);
+        }
+        else
+        {
+            constexpr auto sections = []
+            {
+                std::array<int, NumActive> s {};
+                int n = 0;
+
+                for (int i = 0; i < NumLowCut; ++i)
+                    s[(size_t) n++] = i;
+
+                if (PeakActive)
+                    s[(size_t) n++] = PeakSection;
+
+                for (int i = 0; i < NumHighCut; ++i)
+                    s[(size_t) n++] = HighCutSection + i;
+
+                return s;
+            }();
+
+            float c[NumActive][5];
+            float z1[NumActive], z2[NumActive];
+
+            for (int s = 0; s < NumActive; ++s)
+            {
+                const auto* sectionCoefficients = coefficients[(size_t) sections[(size_t) s]];
+
+                for (int k = 0; k < 5; ++k)
+                    c[s][k] = sectionCoefficients[k];
+
+                z1[s] = state.z[(size_t) sections[(size_t) s]][0];
+                z2[s] = state.z[(size_t) sections[(size_t) s]][1];
+            }
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                auto x = samples[i];
+
+                for (int s = 0; s < NumActive; ++s)
+                {
+                    auto y = c[s][0] * x + z1[s];
+                    z1[s] = c[s][1] * x - c[s][3] * y + z2[s];
+                    z2[s] = c[s][2] * x - c[s][4] * y;
+                    x = y;
+                }
+
+                samples[i] = x;
+            }
+
+            for (int s = 0; s < NumActive; ++s)
+            {
+                state.z[(size_t) sections[(size_t) s]][0] = juce::dsp::util::snapToZero(z1[s]);
+                state.z[(size_t) sections[(size_t) s]][1] = juce::dsp::util::snapToZero(z2[s]);
+            }
+        }
+    }
+
+    namespace detail
+    {
+        constexpr int NumSlopes = 4;
+        constexpr int NumBypassCombinations = 8;
+        constexpr int NumKernels = NumSlopes * NumSlopes * NumBypassCombinations;
+
+        constexpr int getIndex(int lowCutSlope, int highCutSlope, bool lowCutBypassed, bool peakBypassed, bool highCutBypassed)
+        {
+            auto bypassMask = (lowCutBypassed ? 1 : 0) | (peakBypassed ? 2 : 0) | (highCutBypassed ? 4 : 0);
+            return (lowCutSlope * NumSlopes + highCutSlope) * NumBypassCombinations + bypassMask;
+        }
+
+        template<int Index>
+        constexpr Kernel makeKernel()
+        {
+            constexpr int lowCutSlope = Index / (NumSlopes * NumBypassCombinations);
+            constexpr int highCutSlope = (Index / NumBypassCombinations) % NumSlopes;
+            constexpr int bypassMask = Index % NumBypassCombinations;
+
+            constexpr int numLowCut = (bypassMask & 1) ? 0 : lowCutSlope + 1;
+            constexpr bool peakActive = (bypassMask & 2) == 0;
+            constexpr int numHighCut = (bypassMask & 4) ? 0 : highCutSlope + 1;
+
+            return &process<numLowCut, peakActive, numHighCut>;
+        }
+
+        template<size_t... Indices>
+        constexpr std::array<Kernel, sizeof...(Indices)> makeKernelTable(std::index_sequence<Indices...>)
+        {
+            return { makeKernel<(int) Indices>()... };
+        }
+    }
+
+    // Slopes are the Slope enum values, 0 for 12 dB/Oct up to 3 for 48 dB/Oct
+    inline Kernel getKernel(int lowCutSlope, int highCutSlope, bool lowCutBypassed, bool peakBypassed, bool highCutBypassed)
+    {
+        static constexpr auto table = detail::makeKernelTable(std::make_index_sequence<detail::NumKernels>());
+
+        jassert(juce::isPositiveAndBelow(lowCutSlope, detail::NumSlopes));
+        jassert(juce::isPositiveAndBelow(highCutSlope, detail::NumSlopes));
+
+        return table[(size_t) detail::getIndex(lowCutSlope, highCutSlope, lowCutBypassed, peakBypassed, highCutBypassed)];
+    }
+}
@@ -0,0 +1,85 @@
+#include "ChannelWorkers.h"
+
+#include <thread>
+
+ChannelWorkers::Worker::Worker(ChannelWorkers& o, int i)
+    : juce::Thread("ColinasEQ channel worker " + juce::String(i)), owner(o), index(i)
+{
+}
+
+void ChannelWorkers::Worker::run()
+{
+    /** The caller's share runs under processBlock's flags, so the workers' channels have to come out the same */
+    juce::ScopedNoDenormals noDenormals;
+
+    while (! threadShouldExit())
+    {
+        wakeUp.wait(-1);
+
+        if (threadShouldExit())
+            return;
+
+        owner.runShare(index + 1);
+        owner.pendingWorkers.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+ChannelWorkers::~ChannelWorkers()
+{
+    stop();
+}
+
+void ChannelWorkers::start(int numWorkers)
+{
+    if ((int) workers.size() == numWorkers)
+        return;
+
+    stop();
+
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>(*this, i));
+        workers.back()->startThread();
+    }
+}
+
+void ChannelWorkers::stop()
+{
+    for (auto& worker : workers)
+    {
+        worker->signalThreadShouldExit();
+        worker->wakeUp.signal();
+    }
+
+    for (auto& worker : workers)
+        worker->stopThread(1000);
+
+    workers.clear();
+}
+
+void ChannelWorkers::run(const ChannelTask* tasks, int numTasks)
+{
+    currentTasks = tasks;
+    currentNumTasks = numTasks;
+
+    /** Only wake the workers that have a task */
+    const auto numToWake = juce::jmin((int) workers.size(), numTasks - 1);
+    pendingWorkers.store(juce::jmax(0, numToWake), std::memory_order_relaxed);
+
+    for (int i = 0; i < numToWake; ++i)
+        workers[(size_t) i]->wakeUp.signal();
+
+    runShare(0);
+
+    /** The release in the workers' decrement makes their output visible here */
+    while (pendingWorkers.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+}
+
+void ChannelWorkers::runShare(int participant)
+{
+    const auto numParticipants = juce::jmin((int) workers.size(), currentNumTasks - 1) + 1;
+
+    for (int t = participant; t < currentNumTasks; t += numParticipants)
+        currentTasks[t].run();
+}
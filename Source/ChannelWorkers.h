@@ -0,0 +1,62 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "ChainKernels.h"
+
+// One channel's run through the chain kernel
+struct ChannelTask
+{
+    ChainKernels::Kernel kernel = nullptr;
+    const ChainKernels::SectionCoefficients* coefficients = nullptr;
+    ChainKernels::State* state = nullptr;
+    float* samples = nullptr;
+    int numSamples = 0;
+
+    void run() const { kernel(*coefficients, *state, samples, numSamples); }
+};
+
+/**
+ A small pool of persistent threads that share out per-channel chain processing.
+
+ Only meant for offline rendering: workers sleep on an event between blocks, which a
+ realtime thread could never afford to wake. The calling thread takes its own share of
+ the tasks, then waits on an atomic countdown the workers release, without taking a lock.
+ */
+class ChannelWorkers
+{
+public:
+    ~ChannelWorkers();
+
+    /** Starts numWorkers threads, or stops them all for 0. Not from the audio thread */
+    void start(int numWorkers);
+    void stop();
+    bool isRunning() const { return ! workers.empty(); }
+
+    /** Runs every task and returns once all of them are done. tasks must outlive the call */
+    void run(const ChannelTask* tasks, int numTasks);
+
+private:
+    struct Worker : juce::Thread
+    {
+        Worker(ChannelWorkers& owner, int index);
+        void run() override;
+
+        ChannelWorkers& owner;
+        const int index;
+        juce::WaitableEvent wakeUp;
+    };
+
+    /** Runs the tasks for one participant. The caller is participant 0, worker i is i + 1 */
+    void runShare(int participant);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    const ChannelTask* currentTasks = nullptr;
+    int currentNumTasks = 0;
+    std::atomic<int> pendingWorkers { 0 };
+};
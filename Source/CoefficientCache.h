@@ -0,0 +1,122 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+// A designed band: one biquad for the peak, one per active stage for the cut filters
+using CoefficientSet = juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>>;
+using CoefficientSetPtr = std::shared_ptr<const CoefficientSet>;
+
+// Everything a band design depends on. Fields a band does not use are left at zero
+struct CoefficientKey
+{
+    int band { 0 };
+    float freq { 0 }, quality { 0 }, gainDecibels { 0 };
+    int slope { 0 };
+    int design { 0 };
+    double sampleRate { 0 };
+
+    bool operator==(const CoefficientKey& other) const noexcept
+    {
+        return band == other.band
+            && freq == other.freq
+            && quality == other.quality
+            && gainDecibels == other.gainDecibels
+            && slope == other.slope
+            && design == other.design
+            && sampleRate == other.sampleRate;
+    }
+};
+
+struct CoefficientKeyHash
+{
+    size_t operator()(const CoefficientKey& key) const noexcept
+    {
+        size_t seed = std::hash<int>()(key.band);
+
+        auto combine = [&seed](size_t h)
+        {
+            seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        };
+
+        combine(std::hash<float>()(key.freq));
+        combine(std::hash<float>()(key.quality));
+        combine(std::hash<float>()(key.gainDecibels));
+        combine(std::hash<int>()(key.slope));
+        combine(std::hash<int>()(key.design));
+        combine(std::hash<double>()(key.sampleRate));
+
+        return seed;
+    }
+};
+
+/**
+ Process-wide cache of designed filter coefficients.
+
+ Hold it through a juce::SharedResourcePointer<CoefficientCache> so every plugin instance and
+ editor in the process shares one cache, and it is deleted with the last instance.
+ Returned sets are immutable and stay valid after eviction for as long as they are held.
+ */
+class CoefficientCache
+{
+public:
+    /**
+     Returns the cached set for 'key', or calls 'design' (which must return a CoefficientSet)
+     and caches the result. The design runs outside the lock.
+     */
+    template<typename DesignFunction>
+    CoefficientSetPtr getOrDesign(const CoefficientKey& key, DesignFunction&& design)
+    {
+        {
+            const juce::SpinLock::ScopedLockType lock(mutex);
+            if (auto found = lookup.find(key); found != lookup.end())
+            {
+                // move to the front so it is the most recently used entry
+                entries.splice(entries.begin(), entries, found->second);
+                return found->second->second;
+            }
+        }
+
+        auto designed = std::make_shared<const CoefficientSet>(design());
+
+        const juce::SpinLock::ScopedLockType lock(mutex);
+        if (auto found = lookup.find(key); found != lookup.end())
+            return found->second->second; // another thread designed it in the meantime
+
+        entries.emplace_front(key, designed);
+        lookup.emplace(key, entries.begin());
+
+        if ((int)entries.size() > Capacity)
+        {
+            lookup.erase(entries.back().first);
+            entries.pop_back();
+        }
+
+        return designed;
+    }
+
+    int getNumEntries() const
+    {
+        const juce::SpinLock::ScopedLockType lock(mutex);
+        return (int)entries.size();
+    }
+
+    void clear()
+    {
+        const juce::SpinLock::ScopedLockType lock(mutex);
+        lookup.clear();
+        entries.clear();
+    }
+
+private:
+    static constexpr int Capacity = 256;
+
+    using Entry = std::pair<CoefficientKey, CoefficientSetPtr>;
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<CoefficientKey, std::list<Entry>::iterator, CoefficientKeyHash> lookup;
+
+    mutable juce::SpinLock mutex;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <vector>
+
+#include "PluginProcessor.h"
+
+enum FFTOrder
+{
+    order2048 = 11,
+    order4096 = 12,
+    order8192 = 13
+};
+
+/**
+ Produces the spectra of a stereo pair with one complex FFT.
+ The left channel goes in the real part and the right channel in the imaginary part,
+ and the conjugate symmetry of real signals separates the two spectra afterwards.
+ Both channels share one window table.
+ */
+template<typename BlockType>
+struct FFTDataGenerator
+{
+    /**
+     produces the FFT data from the first two channels of an audio buffer.
+     The pushed block holds the left channel's bins followed by the right channel's.
+     */
+    void produceFFTDataForRendering(const juce::AudioBuffer<float>& audioData, const float negativeInfinity)
+    {
+        jassert(audioData.getNumChannels() >= 2);
+        
+        const auto fftSize = getFFTSize();
+        auto* left = audioData.getReadPointer(0);
+        auto* right = audioData.getReadPointer(1);
+        
+        // window both channels while packing them into one complex signal
+        for( int i = 0; i < fftSize; ++i )
+            timeData[i] = { left[i] * window[i], right[i] * window[i] };
+        
+        forwardFFT->perform(timeData.data(), frequencyData.data(), false);
+        
+        int numBins = (int)fftSize / 2;
+        
+        auto normalize = [numBins, negativeInfinity](float v)
+        {
+            if( std::isinf(v) || std::isnan(v) )
+                v = 0.f;
+            
+            return juce::Decibels::gainToDecibels(v / float(numBins), negativeInfinity);
+        };
+        
+        // L[k] = (Z[k] + conj(Z[N-k])) / 2 and R[k] = (Z[k] - conj(Z[N-k])) / 2j
+        for( int i = 0; i < numBins; ++i )
+        {
+            auto z = frequencyData[i];
+            auto mirror = std::conj(frequencyData[(fftSize - i) & (fftSize - 1)]);
+            
+            fftData[i] = normalize(std::abs(z + mirror) * 0.5f);
+            fftData[numBins + i] = normalize(std::abs(z - mirror) * 0.5f);
+        }
+        
+        fftDataFifo.push(fftData);
+    }
+    
+    void changeOrder(FFTOrder newOrder)
+    {
+        //when you change order, recreate the window, forwardFFT, fifo, fftData
+        //things that need recreating should be created on the heap via std::make_unique<>
+        
+        order = newOrder;
+        auto fftSize = getFFTSize();
+        
+        forwardFFT = std::make_unique<juce::dsp::FFT>(order);
+        
+        window.resize(fftSize);
+        juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(), (size_t)fftSize,
+                                                                 juce::dsp::WindowingFunction<float>::blackmanHarris);
+        
+        timeData.assign(fftSize, {});
+        frequencyData.assign(fftSize, {});
+        
+        fftData.clear();
+        fftData.resize(fftSize, 0);
+
+        // frames are read as soon as they are produced
+        fftDataFifo.setCapacity(1);
+        fftDataFifo.prepare(fftData.size());
+    }
+    //==============================================================================
+    int getFFTSize() const { return 1 << order; }
+    int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
+    //==============================================================================
+    bool getFFTData(BlockType& fftData) { return fftDataFifo.pull(fftData); }
+    
+    size_t getNumBytes() const
+    {
+        return sizeof(*this)
+             + window.capacity() * sizeof(float)
+             + (timeData.capacity() + frequencyData.capacity()) * sizeof(juce::dsp::Complex<float>)
+             + fftData.capacity() * sizeof(float)
+             + fftDataFifo.getNumBytes();
+    }
+private:
+    FFTOrder order;
+    BlockType fftData;
+    std::unique_ptr<juce::dsp::FFT> forwardFFT;
+    std::vector<float> window;
+    std::vector<juce::dsp::Complex<float>> timeData, frequencyData;
+    
+    Fifo<BlockType> fftDataFifo;
+};
@@ -0,0 +1,260 @@
+#include "LevelMeter.h"
+
+namespace
+{
+    /** The 4x interpolation filter of ITU-R BS.1770-4, annex 2, one row per phase */
+    constexpr float truePeakPhases[4][12]
+    {
+        {  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f, -0.0594482421875f,  0.1373291015625f,
+           0.9721679687500f, -0.1022949218750f,  0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+        { -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f, -0.1665039062500f,  0.4650878906250f,
+           0.7797851562500f, -0.2003173828125f,  0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+        { -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f, -0.2003173828125f,  0.7797851562500f,
+           0.4650878906250f, -0.1665039062500f,  0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+        { -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f, -0.1022949218750f,  0.9721679687500f,
+           0.1373291015625f, -0.0594482421875f,  0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f }
+    };
+
+    /**
+     Peak magnitude and sum of squares in one pass. The lanes are independent, so the
+     compiler can vectorise the loop without reassociating any additions
+     */
+    void getPeakAndEnergy(const float* samples, int numSamples, float& peak, double& energy)
+    {
+        constexpr int Lanes = 8;
+        float lanePeak[Lanes] {}, laneEnergy[Lanes] {};
+
+        int i = 0;
+        for (; i + Lanes <= numSamples; i += Lanes)
+        {
+            for (int lane = 0; lane < Lanes; ++lane)
+            {
+                auto v = samples[i + lane];
+                lanePeak[lane] = juce::jmax(lanePeak[lane], std::abs(v));
+                laneEnergy[lane] += v * v;
+            }
+        }
+
+        for (; i < numSamples; ++i)
+        {
+            lanePeak[0] = juce::jmax(lanePeak[0], std::abs(samples[i]));
+            laneEnergy[0] += samples[i] * samples[i];
+        }
+
+        for (int lane = 0; lane < Lanes; ++lane)
+        {
+            peak = juce::jmax(peak, lanePeak[lane]);
+            energy += laneEnergy[lane];
+        }
+    }
+}
+
+void LevelMeter::prepare(double sampleRate)
+{
+    /** K-weighting at any sample rate, from the analog prototypes behind the 48 kHz coefficients of BS.1770 */
+    {
+        const auto K = std::tan(juce::MathConstants<double>::pi * 1681.974450955533 / sampleRate);
+        const auto Q = 0.7071752369554196;
+        const auto Vh = std::pow(10.0, 3.999843853973347 / 20.0);
+        const auto Vb = std::pow(Vh, 0.4996667741545416);
+        const auto a0 = 1.0 + K / Q + K * K;
+
+        shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+        shelf.b1 = 2.0 * (K * K - Vh) / a0;
+        shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+        shelf.a1 = 2.0 * (K * K - 1.0) / a0;
+        shelf.a2 = (1.0 - K / Q + K * K) / a0;
+    }
+
+    {
+        const auto K = std::tan(juce::MathConstants<double>::pi * 38.13547087602444 / sampleRate);
+        const auto Q = 0.5003270373238773;
+        const auto a0 = 1.0 + K / Q + K * K;
+
+        highPass.b0 = 1.0;
+        highPass.b1 = -2.0;
+        highPass.b2 = 1.0;
+        highPass.a1 = 2.0 * (K * K - 1.0) / a0;
+        highPass.a2 = (1.0 - K / Q + K * K) / a0;
+    }
+
+    binSize = juce::jmax(1, juce::roundToInt(sampleRate * 0.1));
+    reset();
+}
+
+void LevelMeter::reset()
+{
+    kState = {};
+
+    for (auto& history : truePeakHistory)
+        history.fill(0.f);
+
+    samplesInBin = 0;
+    binIndex = 0;
+    numBinsFilled = 0;
+    binEnergy = {};
+    binWeightedEnergy = {};
+    energyHistory = {};
+    weightedEnergyHistory = {};
+
+    for (int ch = 0; ch < MaxChannels; ++ch)
+    {
+        samplePeak[(size_t) ch].store(0.f);
+        truePeak[(size_t) ch].store(0.f);
+        rms[(size_t) ch].store(0.f);
+    }
+
+    shortTermLoudness.store(-100.f);
+}
+
+void LevelMeter::process(const float* const* channels, int numChannels, int numSamples)
+{
+    measuredChannels = juce::jmin(numChannels, MaxChannels);
+    publishedChannels.store(measuredChannels, std::memory_order_relaxed);
+
+    /** Chunks end on bin boundaries */
+    std::array<const float*, MaxChannels> chunk {};
+
+    for (int start = 0; start < numSamples;)
+    {
+        auto length = juce::jmin(numSamples - start, ChunkSize, binSize - samplesInBin);
+
+        for (int ch = 0; ch < measuredChannels; ++ch)
+            chunk[(size_t) ch] = channels[ch] + start;
+
+        measureChunk(chunk.data(), measuredChannels, length);
+
+        start += length;
+        samplesInBin += length;
+
+        if (samplesInBin == binSize)
+            completeBin();
+    }
+}
+
+void LevelMeter::measureChunk(const float* const* channels, int numChannels, int numSamples)
+{
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        const auto* samples = channels[ch];
+        auto peak = 0.f;
+
+        getPeakAndEnergy(samples, numSamples, peak, binEnergy[(size_t) ch]);
+        publishPeak(samplePeak[(size_t) ch], peak);
+        publishPeak(truePeak[(size_t) ch], juce::jmax(peak, getTruePeak(ch, samples, numSamples)));
+
+        /** The K-weighting is recursive, so it is the one serial pass */
+        auto& state = kState[(size_t) ch];
+        double weightedEnergy = 0.0;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto x = (double) samples[i];
+
+            auto y = shelf.b0 * x + state.z1[0];
+            state.z1[0] = shelf.b1 * x - shelf.a1 * y + state.z2[0];
+            state.z2[0] = shelf.b2 * x - shelf.a2 * y;
+
+            auto w = highPass.b0 * y + state.z1[1];
+            state.z1[1] = highPass.b1 * y - highPass.a1 * w + state.z2[1];
+            state.z2[1] = highPass.b2 * y - highPass.a2 * w;
+
+            weightedEnergy += w * w;
+        }
+
+        binWeightedEnergy[(size_t) ch] += weightedEnergy;
+    }
+}
+
+float LevelMeter::getTruePeak(int channel, const float* samples, int numSamples)
+{
+    /** The history keeps the last TruePeakTaps - 1 samples of the previous chunk in front of this one */
+    auto* history = truePeakHistory[(size_t) channel].data();
+    auto* current = history + TruePeakTaps - 1;
+    auto* output = interpolated.data();
+
+    juce::FloatVectorOperations::copy(current, samples, numSamples);
+
+    auto peak = 0.f;
+
+    for (const auto& phase : truePeakPhases)
+    {
+        juce::FloatVectorOperations::clear(output, numSamples);
+
+        for (int tap = 0; tap < TruePeakTaps; ++tap)
+            juce::FloatVectorOperations::addWithMultiply(output, current - tap, phase[tap], numSamples);
+
+        auto range = juce::FloatVectorOperations::findMinAndMax(output, numSamples);
+        peak = juce::jmax(peak, -range.getStart(), range.getEnd());
+    }
+
+    std::copy(history + numSamples, history + numSamples + TruePeakTaps - 1, history);
+    return peak;
+}
+
+void LevelMeter::completeBin()
+{
+    for (int ch = 0; ch < measuredChannels; ++ch)
+    {
+        energyHistory[(size_t) ch][(size_t) binIndex] = binEnergy[(size_t) ch];
+        weightedEnergyHistory[(size_t) ch][(size_t) binIndex] = binWeightedEnergy[(size_t) ch];
+    }
+
+    binEnergy = {};
+    binWeightedEnergy = {};
+    samplesInBin = 0;
+    numBinsFilled = juce::jmin(NumBins, numBinsFilled + 1);
+
+    /** Loudness sums the channels' mean squares, with unit weight for left and right */
+    double loudnessSum = 0.0;
+
+    for (int ch = 0; ch < measuredChannels; ++ch)
+    {
+        double recent = 0.0, total = 0.0;
+
+        for (int i = 0; i < numBinsFilled; ++i)
+        {
+            auto bin = (size_t) ((binIndex - i + NumBins) % NumBins);
+
+            if (i < RmsBins)
+                recent += energyHistory[(size_t) ch][bin];
+
+            total += weightedEnergyHistory[(size_t) ch][bin];
+        }
+
+        auto rmsBins = juce::jmin(RmsBins, numBinsFilled);
+        rms[(size_t) ch].store((float) std::sqrt(recent / (double) (rmsBins * binSize)), std::memory_order_relaxed);
+        loudnessSum += total / (double) (numBinsFilled * binSize);
+    }
+
+    shortTermLoudness.store(juce::jmax(-100.f, (float) (-0.691 + 10.0 * std::log10(loudnessSum + 1.0e-20))),
+                            std::memory_order_relaxed);
+
+    binIndex = (binIndex + 1) % NumBins;
+}
+
+void LevelMeter::publishPeak(std::atomic<float>& published, float peak)
+{
+    /** The reader resets the peak to 0, so only ever raise it */
+    auto current = published.load(std::memory_order_relaxed);
+
+    while (peak > current && ! published.compare_exchange_weak(current, peak, std::memory_order_relaxed))
+    {
+    }
+}
+
+LevelMeter::Reading LevelMeter::read()
+{
+    Reading reading;
+    reading.numChannels = publishedChannels.load(std::memory_order_relaxed);
+
+    for (int ch = 0; ch < MaxChannels; ++ch)
+    {
+        reading.samplePeak[(size_t) ch] = samplePeak[(size_t) ch].exchange(0.f, std::memory_order_relaxed);
+        reading.truePeak[(size_t) ch] = truePeak[(size_t) ch].exchange(0.f, std::memory_order_relaxed);
+        reading.rms[(size_t) ch] = rms[(size_t) ch].load(std::memory_order_relaxed);
+    }
+
+    reading.shortTermLoudness = shortTermLoudness.load(std::memory_order_relaxed);
+    return reading;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <atomic>
+
+/**
+ Sample peak, 4x oversampled true peak, RMS and short-term loudness of up to two channels.
+
+ The work per sample is fixed: one fused peak and sum of squares pass, the 48 tap polyphase
+ interpolator of BS.1770 run as vectorised multiply-adds, and the two K-weighting biquads.
+ Energy is summed into 100 ms bins. RMS covers the last 3 bins, and short-term loudness the last 30.
+
+ Blocks are measured in chunks of at most ChunkSize samples, so nothing is allocated and
+ the scratch space doesn't grow with the block size.
+
+ The audio thread publishes through atomics only. Peaks are held until read, so the reader
+ sees the highest peak since its previous read whatever its frame rate.
+ */
+class LevelMeter
+{
+public:
+    static constexpr int MaxChannels = 2;
+
+    struct Reading
+    {
+        std::array<float, MaxChannels> samplePeak {}, truePeak {}, rms {}; // linear gain
+        float shortTermLoudness = -100.f;                                     // LUFS
+        int numChannels = 0;
+    };
+
+    static constexpr int ChunkSize = 512;
+
+    /** Designs the K-weighting for the sample rate and resets */
+    void prepare(double sampleRate);
+
+    /** Clears the history and the published levels. Audio thread, or before processing starts */
+    void reset();
+
+    /** Audio thread. Channels past MaxChannels are ignored */
+    void process(const float* const* channels, int numChannels, int numSamples);
+
+    /** Peaks since the previous read, and the latest RMS and loudness. One reader only */
+    Reading read();
+
+private:
+    static constexpr int NumBins = 30;      // 3 s of 100 ms bins
+    static constexpr int RmsBins = 3;
+    static constexpr int TruePeakTaps = 12;
+
+    struct Biquad
+    {
+        double b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+    };
+
+    struct KWeightingState
+    {
+        double z1[2] {}, z2[2] {};
+    };
+
+    void measureChunk(const float* const* channels, int numChannels, int numSamples);
+    float getTruePeak(int channel, const float* samples, int numSamples);
+    void completeBin();
+
+    static void publishPeak(std::atomic<float>& published, float peak);
+
+    Biquad shelf, highPass;
+    std::array<KWeightingState, MaxChannels> kState {};
+
+    // The last TruePeakTaps - 1 samples of the previous chunk, followed by the current one
+    std::array<std::array<float, ChunkSize + TruePeakTaps - 1>, MaxChannels> truePeakHistory {};
+    std::array<float, ChunkSize> interpolated {};
+
+    int binSize = 4800;
+    int samplesInBin = 0;
+    int binIndex = 0, numBinsFilled = 0;
+    std::array<double, MaxChannels> binEnergy {}, binWeightedEnergy {};
+    std::array<std::array<double, NumBins>, MaxChannels> energyHistory {}, weightedEnergyHistory {};
+    int measuredChannels = 0;
+
+    std::array<std::atomic<float>, MaxChannels> samplePeak {}, truePeak {}, rms {};
+    std::atomic<float> shortTermLoudness { -100.f };
+    std::atomic<int> publishedChannels { 0 };
+};
@@ -0,0 +1,492 @@
+#include "MatchEQ.h"
+
+#include <algorithm>
+#include <complex>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+    constexpr int FFTOrder = 12;
+    constexpr int FFTSize = 1 << FFTOrder;
+    constexpr int NumBins = FFTSize / 2;
+    constexpr int HopSize = FFTSize / 2;
+
+    // Frames read from the file at once. Consecutive reads overlap by FFTSize - HopSize samples
+    constexpr int FramesPerRead = 32;
+
+    // Grid points this far below the loudest point of either file are left out of the fit,
+    // so band-limited material is not matched by boosting noise
+    constexpr float FitFloorDecibels = 60.f;
+
+    /** Runs task(0) to task(numTasks - 1) on the pool, and returns once all of them are done */
+    void parallelFor(juce::ThreadPool& pool, int numTasks, const std::function<void(int)>& task)
+    {
+        std::atomic<int> remaining { numTasks };
+        juce::WaitableEvent done;
+
+        for (int i = 0; i < numTasks; ++i)
+        {
+            pool.addJob([&, i]
+            {
+                task(i);
+
+                if (remaining.fetch_sub(1) == 1)
+                    done.signal();
+
+                return juce::ThreadPoolJob::jobHasFinished;
+            });
+        }
+
+        done.wait(-1);
+    }
+
+    /** Maps just the samples a chunk needs where the format supports it, otherwise falls back to a streaming reader */
+    std::unique_ptr<juce::AudioFormatReader> createChunkReader(juce::AudioFormatManager& formats,
+                                                               const juce::File& file,
+                                                               juce::Range<juce::int64> samples)
+    {
+        if (auto* format = formats.findFormatForFileExtension(file.getFileExtension()))
+        {
+            std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped(format->createMemoryMappedReader(file));
+
+            if (mapped != nullptr && mapped->mapSectionOfFile(samples))
+                return mapped;
+        }
+
+        return std::unique_ptr<juce::AudioFormatReader>(formats.createReaderFor(file));
+    }
+
+    // The fit searches a unit cube. Cut slopes are rounded from their dimension
+    enum Dimension
+    {
+        LowCutFreq,
+        LowCutSlope,
+        PeakFreq,
+        PeakGain,
+        PeakQuality,
+        HighCutFreq,
+        HighCutSlope,
+        NumDimensions
+    };
+
+    using Candidate = std::array<double, NumDimensions>;
+
+    /** The cuts are kept on their own side of 1 kHz, so they can't meet and notch out the whole band */
+    ChainSettings toChainSettings(const Candidate& x, DesignMode designMode)
+    {
+        auto toSlope = [](double v) { return (Slope) juce::jlimit(0, 3, (int) (v * 4.0)); };
+
+        ChainSettings settings;
+        settings.lowCutFreq = (float) juce::mapToLog10(x[LowCutFreq], 20.0, 1000.0);
+        settings.lowCutSlope = toSlope(x[LowCutSlope]);
+        settings.peakFreq = (float) juce::mapToLog10(x[PeakFreq], 20.0, 20000.0);
+        settings.peakGainDecibels = (float) juce::jmap(x[PeakGain], -24.0, 24.0);
+        settings.peakQuality = (float) juce::mapToLog10(x[PeakQuality], 0.1, 10.0);
+        settings.highCutFreq = (float) juce::mapToLog10(x[HighCutFreq], 1000.0, 20000.0);
+        settings.highCutSlope = toSlope(x[HighCutSlope]);
+        settings.designMode = designMode;
+        return settings;
+    }
+
+    /** Rounds to the steps of the parameter ranges in createParameterLayout */
+    ChainSettings snapToParameterSteps(ChainSettings settings)
+    {
+        settings.lowCutFreq = (float) juce::roundToInt(settings.lowCutFreq);
+        settings.highCutFreq = (float) juce::roundToInt(settings.highCutFreq);
+        settings.peakFreq = (float) juce::roundToInt(settings.peakFreq);
+        settings.peakGainDecibels = (float) juce::roundToInt(settings.peakGainDecibels * 2.f) * 0.5f;
+        settings.peakQuality = (float) juce::roundToInt(settings.peakQuality * 20.f) * 0.05f;
+        return settings;
+    }
+
+    /**
+     Evaluates the chain's response on the grid. z^-1 and z^-2 are worked out once per fit,
+     so every section costs two complex multiply-adds per point
+     */
+    struct ResponseGrid
+    {
+        ResponseGrid(double sampleRate)
+        {
+            for (int point = 0; point < MatchEQ::NumPoints; ++point)
+            {
+                auto omega = juce::MathConstants<double>::twoPi * MatchEQ::getPointFrequency(point) / sampleRate;
+                z1[(size_t) point] = std::polar(1.0, -omega);
+                z2[(size_t) point] = std::polar(1.0, -2.0 * omega);
+            }
+        }
+
+        void addSection(const juce::dsp::IIR::Coefficients<float>& coefficients, std::array<double, MatchEQ::NumPoints>& decibels) const
+        {
+            const auto* c = coefficients.getRawCoefficients();
+            const bool secondOrder = coefficients.getFilterOrder() == 2;
+
+            for (size_t point = 0; point < decibels.size(); ++point)
+            {
+                auto numerator = secondOrder ? (double) c[0] + (double) c[1] * z1[point] + (double) c[2] * z2[point]
+                                             : (double) c[0] + (double) c[1] * z1[point];
+                auto denominator = secondOrder ? 1.0 + (double) c[3] * z1[point] + (double) c[4] * z2[point]
+                                               : 1.0 + (double) c[2] * z1[point];
+
+                decibels[point] += 10.0 * std::log10(std::norm(numerator) / std::norm(denominator) + 1.0e-30);
+            }
+        }
+
+        std::array<std::complex<double>, MatchEQ::NumPoints> z1, z2;
+    };
+
+    double getFitError(const Candidate& x,
+                       const std::array<float, MatchEQ::NumPoints>& targetCurve,
+                       const ResponseGrid& grid,
+                       double sampleRate,
+                       DesignMode designMode)
+    {
+        auto settings = toChainSettings(x, designMode);
+
+        std::array<double, MatchEQ::NumPoints> response {};
+
+        grid.addSection(*makePeakFilter(settings, sampleRate), response);
+
+        for (auto* section : makeLowCutFilter(settings, sampleRate))
+            grid.addSection(*section, response);
+
+        for (auto* section : makeHighCutFilter(settings, sampleRate))
+            grid.addSection(*section, response);
+
+        /** The EQ has no output gain, so only the shape counts: the mean difference is taken out */
+        double sum = 0.0, sumOfSquares = 0.0;
+        int numValid = 0;
+
+        for (size_t point = 0; point < response.size(); ++point)
+        {
+            if (std::isnan(targetCurve[point]))
+                continue;
+
+            auto difference = response[point] - (double) targetCurve[point];
+            sum += difference;
+            sumOfSquares += difference * difference;
+            ++numValid;
+        }
+
+        if (numValid == 0)
+            return 0.0;
+
+        auto mean = sum / numValid;
+        return sumOfSquares / numValid - mean * mean;
+    }
+}
+
+MatchEQ::MatchEQ()
+    : juce::Thread("ColinasEQ match EQ"),
+      pool(juce::jmax(1, juce::SystemStats::getNumCpus() - 1))
+{
+}
+
+MatchEQ::~MatchEQ()
+{
+    alive->store(false);
+    cancelled = true;
+    stopThread(10000);
+}
+
+void MatchEQ::start(const juce::File& reference, const juce::File& target,
+                    double sampleRate, DesignMode designMode,
+                    std::function<void(const Result&)> onFinished)
+{
+    jassert(! isThreadRunning());
+
+    if (isThreadRunning())
+        return;
+
+    referenceFile = reference;
+    targetFile = target;
+    designSampleRate = sampleRate;
+    design = designMode;
+    finishedCallback = std::move(onFinished);
+    cancelled = false;
+
+    startThread();
+}
+
+void MatchEQ::run()
+{
+    Result result;
+    Spectrum reference, target;
+
+    if (analyseFile(referenceFile, pool, reference, result.error, cancelled)
+        && analyseFile(targetFile, pool, target, result.error, cancelled))
+        result = fit(reference, target, designSampleRate, design, pool, cancelled);
+
+    if (cancelled)
+        return;
+
+    juce::MessageManager::callAsync([stillAlive = alive, callback = finishedCallback, result]
+    {
+        if (stillAlive->load())
+            callback(result);
+    });
+}
+
+bool MatchEQ::analyseFile(const juce::File& file, juce::ThreadPool& pool, Spectrum& spectrum,
+                          juce::String& error, const std::atomic<bool>& cancelled)
+{
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    std::unique_ptr<juce::AudioFormatReader> header(formats.createReaderFor(file));
+
+    if (header == nullptr)
+    {
+        error = "Can't read " + file.getFileName();
+        return false;
+    }
+
+    const auto length = header->lengthInSamples;
+    const auto numChannels = (int) juce::jmin(2u, header->numChannels);
+    const auto fileSampleRate = header->sampleRate;
+    header.reset();
+
+    if (length < FFTSize || fileSampleRate <= 0.0)
+    {
+        error = file.getFileName() + " is too short to analyse";
+        return false;
+    }
+
+    /** One chunk of consecutive frames per pool thread */
+    const auto numFrames = (length - FFTSize) / HopSize + 1;
+    const auto numChunks = (int) juce::jlimit((juce::int64) 1, (juce::int64) pool.getNumThreads(), numFrames / FramesPerRead);
+
+    std::vector<std::vector<double>> chunkPower((size_t) numChunks, std::vector<double>(NumBins + 1, 0.0));
+    std::atomic<bool> readFailed { false };
+
+    parallelFor(pool, numChunks, [&](int chunk)
+    {
+        const auto firstFrame = numFrames * chunk / numChunks;
+        const auto endFrame = numFrames * (chunk + 1) / numChunks;
+
+        juce::AudioFormatManager chunkFormats;
+        chunkFormats.registerBasicFormats();
+
+        auto reader = createChunkReader(chunkFormats, file, { firstFrame * HopSize, (endFrame - 1) * HopSize + FFTSize });
+
+        if (reader == nullptr)
+        {
+            readFailed = true;
+            return;
+        }
+
+        juce::dsp::FFT fft(FFTOrder);
+        juce::dsp::WindowingFunction<float> window((size_t) FFTSize, juce::dsp::WindowingFunction<float>::hann, false);
+        std::vector<float> fftData(FFTSize * 2);
+        juce::AudioBuffer<float> buffer(numChannels, (FramesPerRead - 1) * HopSize + FFTSize);
+        auto& power = chunkPower[(size_t) chunk];
+
+        for (auto frame = firstFrame; frame < endFrame; frame += FramesPerRead)
+        {
+            if (cancelled)
+                return;
+
+            const auto framesThisRead = (int) juce::jmin((juce::int64) FramesPerRead, endFrame - frame);
+            const auto numSamples = (framesThisRead - 1) * HopSize + FFTSize;
+
+            if (! reader->read(&buffer, 0, numSamples, frame * HopSize, true, numChannels > 1))
+            {
+                readFailed = true;
+                return;
+            }
+
+            /** Power of every channel is summed, so out of phase content isn't lost the way a mid signal would lose it */
+            for (int f = 0; f < framesThisRead; ++f)
+            {
+                for (int ch = 0; ch < numChannels; ++ch)
+                {
+                    std::copy_n(buffer.getReadPointer(ch, f * HopSize), FFTSize, fftData.begin());
+                    window.multiplyWithWindowingTable(fftData.data(), (size_t) FFTSize);
+                    fft.performFrequencyOnlyForwardTransform(fftData.data(), true);
+
+                    for (size_t bin = 0; bin < power.size(); ++bin)
+                        power[bin] += (double) fftData[bin] * (double) fftData[bin];
+                }
+            }
+        }
+    });
+
+    if (cancelled)
+    {
+        error = "Cancelled";
+        return false;
+    }
+
+    if (readFailed)
+    {
+        error = "Can't read " + file.getFileName();
+        return false;
+    }
+
+    std::vector<double> power(NumBins + 1, 0.0);
+
+    for (const auto& chunk : chunkPower)
+        for (size_t bin = 0; bin < power.size(); ++bin)
+            power[bin] += chunk[bin];
+
+    const auto numTransforms = (double) numFrames * numChannels;
+    const auto binWidth = fileSampleRate / FFTSize;
+
+    /** 1/3 octave around each point, and never less than one bin */
+    for (int point = 0; point < NumPoints; ++point)
+    {
+        auto frequency = (double) getPointFrequency(point);
+
+        if (frequency > fileSampleRate * MaxDesignFrequencyRatio)
+        {
+            spectrum[(size_t) point] = std::numeric_limits<float>::quiet_NaN();
+            continue;
+        }
+
+        auto firstBin = juce::jlimit(1, NumBins, (int) std::ceil(frequency * std::pow(2.0, -1.0 / 6.0) / binWidth));
+        auto lastBin = juce::jlimit(firstBin, NumBins, (int) std::floor(frequency * std::pow(2.0, 1.0 / 6.0) / binWidth));
+
+        double sum = 0.0;
+
+        for (int bin = firstBin; bin <= lastBin; ++bin)
+            sum += power[(size_t) bin];
+
+        auto meanPower = sum / (numTransforms * (lastBin - firstBin + 1));
+        spectrum[(size_t) point] = (float) (10.0 * std::log10(meanPower + 1.0e-30));
+    }
+
+    return true;
+}
+
+MatchEQ::Result MatchEQ::fit(const Spectrum& reference, const Spectrum& target, double sampleRate,
+                             DesignMode designMode, juce::ThreadPool& pool, const std::atomic<bool>& cancelled)
+{
+    Result result;
+
+    if (sampleRate <= 0.0)
+        sampleRate = 48000.0;
+
+    /** What the EQ has to add to the target, with the points either file can't speak for left out */
+    auto loudest = [](const Spectrum& s)
+    {
+        auto level = -std::numeric_limits<float>::infinity();
+
+        for (auto v : s)
+            if (! std::isnan(v))
+                level = juce::jmax(level, v);
+
+        return level;
+    };
+
+    const auto referenceFloor = loudest(reference) - FitFloorDecibels;
+    const auto targetFloor = loudest(target) - FitFloorDecibels;
+
+    Spectrum targetCurve;
+    int numValid = 0;
+
+    for (int point = 0; point < NumPoints; ++point)
+    {
+        auto i = (size_t) point;
+        auto usable = ! std::isnan(reference[i]) && ! std::isnan(target[i])
+                   && reference[i] > referenceFloor && target[i] > targetFloor
+                   && getPointFrequency(point) < sampleRate * MaxDesignFrequencyRatio;
+
+        targetCurve[i] = usable ? reference[i] - target[i] : std::numeric_limits<float>::quiet_NaN();
+
+        if (usable)
+            ++numValid;
+    }
+
+    if (numValid < 8)
+    {
+        result.error = "The files don't share enough of the spectrum to match";
+        return result;
+    }
+
+    const ResponseGrid grid(sampleRate);
+
+    /** Cross-entropy search. Every generation draws a batch around the mean and refits the distribution to the elites */
+    constexpr int BatchSize = 64;
+    constexpr int NumElites = 12;
+    constexpr int NumGenerations = 60;
+    constexpr double Smoothing = 0.7;
+    constexpr double MinDeviation = 0.002;
+
+    /** Starts flat: both cuts at the ends of their ranges and a 0 dB peak */
+    Candidate mean { 0.0, 0.0, 0.5, 0.5, 0.5, 1.0, 0.0 };
+    Candidate deviation;
+    deviation.fill(0.3);
+
+    Candidate best = mean;
+    auto bestError = getFitError(best, targetCurve, grid, sampleRate, designMode);
+
+    std::vector<Candidate> batch(BatchSize);
+    std::vector<double> errors(BatchSize);
+    std::vector<int> order(BatchSize);
+
+    juce::Random random(0x4d617463);    // fixed seed, so the same files always give the same match
+    const auto numTasks = juce::jmax(1, pool.getNumThreads());
+
+    for (int generation = 0; generation < NumGenerations && ! cancelled; ++generation)
+    {
+        for (auto& candidate : batch)
+        {
+            for (size_t d = 0; d < candidate.size(); ++d)
+            {
+                /** Box-Muller */
+                auto gaussian = std::sqrt(-2.0 * std::log(1.0 - random.nextDouble()))
+                              * std::cos(juce::MathConstants<double>::twoPi * random.nextDouble());
+
+                candidate[d] = juce::jlimit(0.0, 1.0, mean[d] + deviation[d] * gaussian);
+            }
+        }
+
+        /** The best so far always takes part, so a bad generation can't lose it */
+        batch[0] = best;
+
+        parallelFor(pool, numTasks, [&](int task)
+        {
+            for (int i = task; i < BatchSize; i += numTasks)
+                errors[(size_t) i] = getFitError(batch[(size_t) i], targetCurve, grid, sampleRate, designMode);
+        });
+
+        std::iota(order.begin(), order.end(), 0);
+        std::partial_sort(order.begin(), order.begin() + NumElites, order.end(),
+                          [&](int a, int b) { return errors[(size_t) a] < errors[(size_t) b]; });
+
+        if (errors[(size_t) order[0]] < bestError)
+        {
+            bestError = errors[(size_t) order[0]];
+            best = batch[(size_t) order[0]];
+        }
+
+        for (size_t d = 0; d < mean.size(); ++d)
+        {
+            double eliteMean = 0.0, eliteSquares = 0.0;
+
+            for (int e = 0; e < NumElites; ++e)
+            {
+                auto v = batch[(size_t) order[(size_t) e]][d];
+                eliteMean += v;
+                eliteSquares += v * v;
+            }
+
+            eliteMean /= NumElites;
+            auto eliteDeviation = std::sqrt(juce::jmax(0.0, eliteSquares / NumElites - eliteMean * eliteMean));
+
+            mean[d] = Smoothing * eliteMean + (1.0 - Smoothing) * mean[d];
+            deviation[d] = juce::jmax(MinDeviation, Smoothing * eliteDeviation + (1.0 - Smoothing) * deviation[d]);
+        }
+    }
+
+    if (cancelled)
+    {
+        result.error = "Cancelled";
+        return result;
+    }
+
+    result.succeeded = true;
+    result.settings = snapToParameterSteps(toChainSettings(best, designMode));
+    result.rmsErrorDecibels = (float) std::sqrt(bestError);
+    return result;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <atomic>
+#include <functional>
+
+#include "PluginProcessor.h"
+
+/**
+ Fits the EQ's bands so a target recording takes on the tonal balance of a reference.
+
+ Both files are reduced to long-term average spectra with Welch's method: Hann windowed
+ frames at 50% overlap, power averaged over the whole file. Each file is split into one
+ chunk per pool thread, and each chunk is streamed through its own reader, memory-mapped
+ where the format allows it. The spectra are then smoothed onto a 1/3 octave log grid.
+
+ The fit minimises the RMS difference, in dB, between the chain's response and
+ reference minus target, ignoring the overall level. It is a cross-entropy search: every
+ generation a batch of candidate settings is evaluated in parallel, and the next batch is
+ drawn around the best of them.
+
+ Everything runs on a background thread. The result is delivered on the message thread.
+ */
+class MatchEQ : private juce::Thread
+{
+public:
+    static constexpr int NumPoints = 96;
+
+    // Level in dB at each grid point. Points a file cannot represent are NaN
+    using Spectrum = std::array<float, NumPoints>;
+
+    struct Result
+    {
+        bool succeeded = false;
+        juce::String error;
+        ChainSettings settings;
+        float rmsErrorDecibels = 0.f;
+    };
+
+    MatchEQ();
+    ~MatchEQ() override;
+
+    /**
+     Starts matching target to reference. The bands are designed at sampleRate with designMode.
+     onFinished is called on the message thread, unless the MatchEQ is deleted first
+     */
+    void start(const juce::File& reference, const juce::File& target,
+               double sampleRate, DesignMode designMode,
+               std::function<void(const Result&)> onFinished);
+
+    bool isRunning() const { return isThreadRunning(); }
+
+    static float getPointFrequency(int point)
+    {
+        return juce::mapToLog10((float) point / (float) (NumPoints - 1), 20.f, 20000.f);
+    }
+
+    /** Long-term average spectrum of a file. Blocks until every chunk is done */
+    static bool analyseFile(const juce::File& file, juce::ThreadPool& pool, Spectrum& spectrum,
+                            juce::String& error, const std::atomic<bool>& cancelled);
+
+    /** The settings whose response best follows reference minus target */
+    static Result fit(const Spectrum& reference, const Spectrum& target, double sampleRate,
+                      DesignMode designMode, juce::ThreadPool& pool, const std::atomic<bool>& cancelled);
+
+private:
+    void run() override;
+
+    juce::ThreadPool pool;
+    std::atomic<bool> cancelled { false };
+
+    juce::File referenceFile, targetFile;
+    double designSampleRate = 48000.0;
+    DesignMode design = Design_Bilinear;
+    std::function<void(const Result&)> finishedCallback;
+
+    // Cleared when the MatchEQ goes away, so a late result is dropped
+    std::shared_ptr<std::atomic<bool>> alive = std::make_shared<std::atomic<bool>>(true);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MatchEQ)
+};
@@ -0,0 +1,160 @@
+#include "MatchedDesign.h"
+
+namespace
+{
+    constexpr double pi = juce::MathConstants<double>::pi;
+
+    struct Poles
+    {
+        double a1, a2;
+    };
+
+    /** Impulse invariant mapping of the poles of s^2 + s/Q + 1 at omega0 radians per sample */
+    Poles getMatchedPoles(double omega0, double quality)
+    {
+        const auto zeta = 1.0 / (2.0 * quality);
+        const auto decay = std::exp(-zeta * omega0);
+
+        Poles poles;
+        poles.a1 = zeta <= 1.0 ? -2.0 * decay * std::cos(std::sqrt(1.0 - zeta * zeta) * omega0)
+                               : -2.0 * decay * std::cosh(std::sqrt(zeta * zeta - 1.0) * omega0);
+        poles.a2 = decay * decay;
+        return poles;
+    }
+
+    /** Warped frequency terms phi0, phi1, phi2 of the squared magnitude at omega radians per sample */
+    std::array<double, 3> getPhi(double omega)
+    {
+        const auto s = std::sin(omega * 0.5);
+        const auto phi1 = s * s;
+        const auto phi0 = 1.0 - phi1;
+        return { phi0, phi1, 4.0 * phi0 * phi1 };
+    }
+
+    /** A minimum phase numerator whose squared magnitude is B0 phi0 + B1 phi1 + B2 phi2 */
+    std::array<double, 3> getNumerator(double B0, double B1, double B2)
+    {
+        const auto root0 = std::sqrt(B0);
+        const auto root1 = std::sqrt(B1);
+        const auto W = 0.5 * (root0 + root1);
+
+        /** Extreme settings close to Nyquist can ask for more than a biquad can do. Give up the
+            match at the centre frequency rather than the realisability */
+        B2 = juce::jmax(B2, -W * W);
+
+        const auto b0 = 0.5 * (W + std::sqrt(W * W + B2));
+        return { b0, 0.5 * (root0 - root1), -B2 / (4.0 * b0) };
+    }
+
+    MatchedDesign::Biquad makeBoost(double sampleRate, double frequency, double quality, double gain)
+    {
+        const auto omega0 = juce::MathConstants<double>::twoPi * frequency / sampleRate;
+        const auto A = std::sqrt(gain);
+        const auto poles = getMatchedPoles(omega0, quality * A);
+
+        /** Squared magnitude of (s^2 + s A/Q + 1) / (s^2 + s/(A Q) + 1) */
+        auto analogMagnitudeSquared = [=](double omega)
+        {
+            const auto ratio = omega / omega0;
+            const auto real = (1.0 - ratio * ratio) * (1.0 - ratio * ratio);
+            const auto numerator = ratio * A / quality;
+            const auto denominator = ratio / (A * quality);
+            return (real + numerator * numerator) / (real + denominator * denominator);
+        };
+
+        const auto A0 = (1.0 + poles.a1 + poles.a2) * (1.0 + poles.a1 + poles.a2);
+        const auto A1 = (1.0 - poles.a1 + poles.a2) * (1.0 - poles.a1 + poles.a2);
+        const auto A2 = -4.0 * poles.a2;
+
+        /** Unity at DC, the analog gain at Nyquist, and the centre gain at the centre frequency.
+            Centres right at Nyquist are matched a little below it, where phi2 is still usable */
+        const auto matchOmega = juce::jmin(omega0, 0.9 * pi);
+        const auto phi = getPhi(matchOmega);
+
+        const auto B0 = A0;
+        const auto B1 = A1 * analogMagnitudeSquared(pi);
+        const auto B2 = (analogMagnitudeSquared(matchOmega) * (A0 * phi[0] + A1 * phi[1] + A2 * phi[2])
+                         - B0 * phi[0] - B1 * phi[1]) / phi[2];
+
+        const auto b = getNumerator(B0, B1, B2);
+        return { (float) b[0], (float) b[1], (float) b[2], (float) poles.a1, (float) poles.a2 };
+    }
+
+    template<typename SectionDesign>
+    juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>> makeButterworth(int order, SectionDesign&& design)
+    {
+        jassert(order > 0 && order % 2 == 0);
+
+        juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>> sections;
+
+        for (int i = 0; i < order / 2; ++i)
+        {
+            auto quality = 1.0 / (2.0 * std::cos((2.0 * i + 1.0) * pi / (order * 2.0)));
+            sections.add(MatchedDesign::toCoefficients(design(quality)));
+        }
+
+        return sections;
+    }
+}
+
+namespace MatchedDesign
+{
+    Biquad makePeak(double sampleRate, double frequency, double quality, double gain)
+    {
+        jassert(gain > 0.0);
+
+        if (gain >= 1.0)
+            return makeBoost(sampleRate, frequency, quality, gain);
+
+        /** A cut is the inverse of the boost by the same amount. The boost's numerator is
+            minimum phase, so swapping it with the denominator stays stable */
+        auto boost = makeBoost(sampleRate, frequency, quality, 1.0 / gain);
+        auto b0 = boost[0];
+
+        return { 1.f / b0, boost[3] / b0, boost[4] / b0, boost[1] / b0, boost[2] / b0 };
+    }
+
+    Biquad makeLowPass(double sampleRate, double frequency, double quality)
+    {
+        const auto omega0 = juce::MathConstants<double>::twoPi * frequency / sampleRate;
+        const auto poles = getMatchedPoles(omega0, quality);
+        const auto f0 = omega0 / pi;
+
+        /** Unity at DC and the analog gain at Nyquist */
+        const auto r0 = 1.0 + poles.a1 + poles.a2;
+        const auto r1 = (1.0 - poles.a1 + poles.a2) * f0 * f0
+                        / std::sqrt((1.0 - f0 * f0) * (1.0 - f0 * f0) + f0 * f0 / (quality * quality));
+
+        const auto b0 = 0.5 * (r0 + r1);
+        return { (float) b0, (float) (r0 - b0), 0.f, (float) poles.a1, (float) poles.a2 };
+    }
+
+    Biquad makeHighPass(double sampleRate, double frequency, double quality)
+    {
+        const auto omega0 = juce::MathConstants<double>::twoPi * frequency / sampleRate;
+        const auto poles = getMatchedPoles(omega0, quality);
+        const auto f0 = omega0 / pi;
+
+        /** Zero at DC and the analog gain at Nyquist */
+        const auto r1 = (1.0 - poles.a1 + poles.a2)
+                        / std::sqrt((1.0 - f0 * f0) * (1.0 - f0 * f0) + f0 * f0 / (quality * quality));
+
+        const auto b0 = 0.25 * r1;
+        return { (float) b0, (float) (-2.0 * b0), (float) b0, (float) poles.a1, (float) poles.a2 };
+    }
+
+    juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>> makeHighOrderLowPass(double frequency, double sampleRate, int order)
+    {
+        return makeButterworth(order, [&](double quality) { return makeLowPass(sampleRate, frequency, quality); });
+    }
+
+    juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>> makeHighOrderHighPass(double frequency, double sampleRate, int order)
+    {
+        return makeButterworth(order, [&](double quality) { return makeHighPass(sampleRate, frequency, quality); });
+    }
+
+    juce::dsp::IIR::Coefficients<float>::Ptr toCoefficients(const Biquad& biquad)
+    {
+        return new juce::dsp::IIR::Coefficients<float>(biquad[0], biquad[1], biquad[2], 1.f, biquad[3], biquad[4]);
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+
+/**
+ Biquad designs that match the magnitude of the analog prototype all the way up to Nyquist,
+ after M. Vicanek, "Matched Second Order Digital Filters" (2016).
+
+ Poles come from the impulse invariant transform of the analog poles. The numerator is
+ fitted so the digital magnitude equals the analog one at DC, at Nyquist and at the centre
+ frequency. Unlike the bilinear designs there is no cramping towards Nyquist, and the
+ sections cost the same to run.
+ */
+namespace MatchedDesign
+{
+    using Biquad = std::array<float, 5>; // b0, b1, b2, a1, a2 normalised by a0
+
+    /** Same analog prototype as juce::dsp::IIR::Coefficients::makePeakFilter. gain is linear */
+    Biquad makePeak(double sampleRate, double frequency, double quality, double gain);
+    Biquad makeLowPass(double sampleRate, double frequency, double quality);
+    Biquad makeHighPass(double sampleRate, double frequency, double quality);
+
+    /** Butterworth cascades with the same sections, in the same order, as
+        juce::dsp::FilterDesign's high order Butterworth methods. order must be even */
+    juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>> makeHighOrderLowPass(double frequency, double sampleRate, int order);
+    juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>> makeHighOrderHighPass(double frequency, double sampleRate, int order);
+
+    juce::dsp::IIR::Coefficients<float>::Ptr toCoefficients(const Biquad& biquad);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+// Set to 1 in the project's preprocessor definitions to time the editor's painting
+// and build ColinasEQAudioProcessorEditor::runPaintBenchmark
+#ifndef COLINASEQ_ENABLE_PAINT_PROFILING
+ #define COLINASEQ_ENABLE_PAINT_PROFILING 0
+#endif
+
+/**
+ Collects paint times per part of the editor, and reports their percentiles.
+
+ Each timed scope adds to its section's total for the current frame, and endFrame() turns
+ the totals into one sample per section. So a section painted several times per frame,
+ like the sliders, counts as the sum of its paints. The last MaxFrames frames are kept.
+ Message thread only. Share it through a juce::SharedResourcePointer<PaintProfiler>.
+ */
+class PaintProfiler
+{
+public:
+    enum Section
+    {
+        Total,
+        Grid,
+        ResponseCurve,
+        Analyzer,
+        Sliders,
+        NumSections
+    };
+
+    static constexpr int MaxFrames = 1024;
+
+    struct ScopedTimer
+    {
+        ScopedTimer(PaintProfiler& p, Section s) : profiler(p), section(s), start(juce::Time::getHighResolutionTicks()) {}
+
+        ~ScopedTimer()
+        {
+            profiler.frameTicks[(size_t) section] += juce::Time::getHighResolutionTicks() - start;
+            profiler.sectionPainted[(size_t) section] = true;
+        }
+
+        PaintProfiler& profiler;
+        const Section section;
+        const juce::int64 start;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedTimer)
+    };
+
+    /** Records the frame. Sections that weren't painted this frame don't get a sample */
+    void endFrame()
+    {
+        for (size_t section = 0; section < NumSections; ++section)
+        {
+            if (sectionPainted[section])
+            {
+                auto& samples = frameTimes[section];
+                auto ms = (float) (juce::Time::highResolutionTicksToSeconds(frameTicks[section]) * 1000.0);
+
+                if (samples.size() < (size_t) MaxFrames)
+                    samples.push_back(ms);
+                else
+                    samples[(size_t) (numFrames % MaxFrames)] = ms;
+            }
+
+            frameTicks[section] = 0;
+            sectionPainted[section] = false;
+        }
+
+        ++numFrames;
+    }
+
+    void reset()
+    {
+        for (auto& samples : frameTimes)
+            samples.clear();
+
+        frameTicks = {};
+        sectionPainted = {};
+        numFrames = 0;
+    }
+
+    /** p50, p90 and p99 frame times and the worst, in ms, one line per painted section */
+    juce::String getReport() const
+    {
+        static constexpr std::array<const char*, NumSections> names { "Total", "Grid", "Response curve", "Analyzer", "Sliders" };
+
+        juce::String report;
+
+        for (size_t section = 0; section < NumSections; ++section)
+        {
+            auto samples = frameTimes[section];
+
+            if (samples.empty())
+                continue;
+
+            std::sort(samples.begin(), samples.end());
+
+            auto percentile = [&samples](double p)
+            {
+                return samples[juce::jmin(samples.size() - 1, (size_t) (p * (double) samples.size()))];
+            };
+
+            report << juce::String(names[section]).paddedRight(' ', 16)
+                   << " p50 " << juce::String(percentile(0.5), 3)
+                   << "  p90 " << juce::String(percentile(0.9), 3)
+                   << "  p99 " << juce::String(percentile(0.99), 3)
+                   << "  max " << juce::String(samples.back(), 3) << " ms\n";
+        }
+
+        return report;
+    }
+
+private:
+    std::array<std::vector<float>, NumSections> frameTimes;
+    std::array<juce::int64, NumSections> frameTicks {};
+    std::array<bool, NumSections> sectionPainted {};
+    juce::int64 numFrames = 0;
+};
+
+#if COLINASEQ_ENABLE_PAINT_PROFILING
+ #define COLINASEQ_PROFILE_PAINT(profiler, section) \
+    const PaintProfiler::ScopedTimer JUCE_JOIN_MACRO(paintTimer_, __LINE__) (*profiler, PaintProfiler::section)
+#else
+ #define COLINASEQ_PROFILE_PAINT(profiler, section)
+#endif
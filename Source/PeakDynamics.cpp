@@ -0,0 +1,149 @@
+#include "PeakDynamics.h"
+#include "MatchedDesign.h"
+
+void PeakDynamics::prepare(double newSampleRate, int maximumBlockSize)
+{
+    sampleRate = newSampleRate;
+
+    detectionBuffer.setSize(1, maximumBlockSize);
+
+    juce::dsp::ProcessSpec spec;
+    spec.sampleRate = sampleRate;
+    spec.maximumBlockSize = (juce::uint32) maximumBlockSize;
+    spec.numChannels = 1;
+
+    /** Start with a second order design so setBand can write the band-pass in place */
+    detectorFilter.coefficients = new juce::dsp::IIR::Coefficients<float>(1, 0, 0, 1, 0, 0);
+    detectorFilter.prepare(spec);
+
+    /** force setBand to work everything out again for the new sample rate */
+    bandFrequency = 0.f;
+    bandQuality = 0.f;
+
+    reset();
+}
+
+void PeakDynamics::reset()
+{
+    envelope = 0.f;
+    lastDetectorOutput = 0.f;
+    detectorFilter.reset();
+}
+
+bool PeakDynamics::resetIfNonFinite()
+{
+    if (std::isfinite(envelope) && std::isfinite(lastDetectorOutput))
+        return false;
+
+    reset();
+    return true;
+}
+
+void PeakDynamics::setBand(float frequency, float quality, bool matchedDesign)
+{
+    if (frequency == bandFrequency && quality == bandQuality && matchedDesign == bandMatched)
+        return;
+
+    bandFrequency = frequency;
+    bandQuality = quality;
+    bandMatched = matchedDesign;
+
+    /** Constant 0 dB peak band-pass, so only energy inside the band drives the gain */
+    const auto omega = juce::MathConstants<double>::twoPi * juce::jmax(2.0, (double) frequency) / sampleRate;
+    const auto cosOmega = std::cos(omega);
+    const auto detectorAlpha = std::sin(omega) / (2.0 * quality);
+    const auto a0Inverse = 1.0 / (1.0 + detectorAlpha);
+
+    auto* c = detectorFilter.coefficients->getRawCoefficients();
+    c[0] = (float) (detectorAlpha * a0Inverse);
+    c[1] = 0.f;
+    c[2] = (float) (-detectorAlpha * a0Inverse);
+    c[3] = (float) (-2.0 * cosOmega * a0Inverse);
+    c[4] = (float) ((1.0 - detectorAlpha) * a0Inverse);
+
+    /** The peak design shares the detector's omega, so its frequency terms come for free */
+    alpha = detectorAlpha;
+    c2 = -2.0 * cosOmega;
+
+    designStale = true;
+}
+
+void PeakDynamics::design(float gainDecibels)
+{
+    const auto gain = juce::Decibels::decibelsToGain((double) gainDecibels);
+
+    if (bandMatched)
+    {
+        /** The matched poles move with the gain, so there is nothing to keep between gains */
+        designed = MatchedDesign::makePeak(sampleRate, bandFrequency, bandQuality, gain);
+        return;
+    }
+
+    /** Same design as juce::dsp::IIR::Coefficients::makePeakFilter, so it matches the static peak filter at the same gain */
+    const auto A = std::sqrt(gain);
+    const auto alphaTimesA = alpha * A;
+    const auto alphaOverA = alpha / A;
+    const auto a0Inverse = 1.0 / (1.0 + alphaOverA);
+
+    designed = { (float) ((1.0 + alphaTimesA) * a0Inverse),
+                 (float) (c2 * a0Inverse),
+                 (float) ((1.0 - alphaTimesA) * a0Inverse),
+                 (float) (c2 * a0Inverse),
+                 (float) ((1.0 - alphaOverA) * a0Inverse) };
+}
+
+float PeakDynamics::process(const float* const* detectionChannels, int numChannels, int numSamples,
+                            float staticGainDecibels, const PeakDynamicsSettings& settings)
+{
+    jassert(numChannels > 0);
+    jassert(numSamples <= detectionBuffer.getNumSamples());
+
+    /** mix the detection channels down to mono */
+    auto* mono = detectionBuffer.getWritePointer(0);
+    juce::FloatVectorOperations::copy(mono, detectionChannels[0], numSamples);
+
+    for (int ch = 1; ch < numChannels; ++ch)
+        juce::FloatVectorOperations::add(mono, detectionChannels[ch], numSamples);
+
+    if (numChannels > 1)
+        juce::FloatVectorOperations::multiply(mono, 1.f / (float) numChannels, numSamples);
+
+    juce::dsp::AudioBlock<float> block(detectionBuffer.getArrayOfWritePointers(), 1, (size_t) numSamples);
+    detectorFilter.process(juce::dsp::ProcessContextReplacing<float>(block));
+    if (numSamples > 0)
+        lastDetectorOutput = mono[numSamples - 1];
+
+    auto range = juce::FloatVectorOperations::findMinAndMax(mono, numSamples);
+    auto peak = juce::jmax(-range.getStart(), range.getEnd());
+
+    /** One-pole envelope follower, stepped once per sub-block */
+    auto timeMs = peak > envelope ? settings.attackMs : settings.releaseMs;
+    auto coefficient = (float) std::exp(-(double) numSamples / (timeMs * 0.001 * sampleRate));
+    envelope = peak + (envelope - peak) * coefficient;
+
+    /** jlimit lets NaN through, and a NaN gain would poison the band's design. The caller resets the detector */
+    if (! std::isfinite(envelope) || ! std::isfinite(lastDetectorOutput))
+        return juce::jlimit(MinGainDecibels, MaxGainDecibels, staticGainDecibels);
+
+    auto over = juce::Decibels::gainToDecibels(envelope) - settings.thresholdDecibels;
+    auto reduction = over > 0.f ? over * (1.f - 1.f / settings.ratio) : 0.f;
+
+    return juce::jlimit(MinGainDecibels, MaxGainDecibels, staticGainDecibels - reduction);
+}
+
+void PeakDynamics::applyGain(juce::dsp::IIR::Coefficients<float>& coefficients, float gainDecibels)
+{
+    jassert(coefficients.coefficients.size() == 5);
+
+    auto clamped = juce::jlimit(MinGainDecibels, MaxGainDecibels, gainDecibels);
+
+    /** Both chains take the same gain each sub-block, so the second one gets the first one's design */
+    if (designStale || clamped != designedGainDecibels)
+    {
+        design(clamped);
+        designedGainDecibels = clamped;
+        designStale = false;
+    }
+
+    std::copy(designed.begin(), designed.end(), coefficients.getRawCoefficients());
+}
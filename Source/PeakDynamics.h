@@ -0,0 +1,74 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+
+// Settings for the dynamic mode of the peak band
+struct PeakDynamicsSettings
+{
+    bool enabled { false }, useSidechain { false };
+    float thresholdDecibels { 0 }, ratio { 1.f }, attackMs { 10.f }, releaseMs { 100.f };
+};
+
+/**
+ Drives the peak band's gain from a band-limited detector.
+
+ The detector band-passes the detection signal at the peak frequency and follows its
+ peak level once per sub-block. Above the threshold, the band's gain is pulled down from
+ "Peak Gain" by the compressor's gain reduction. With 0 dB "Peak Gain" that makes it a dynamic cut.
+ The band is designed for the current gain at most once per sub-block. Only the terms that
+ depend on the frequency and Q are kept, so a band that moves costs no more than a steady one.
+ */
+class PeakDynamics
+{
+public:
+    void prepare(double sampleRate, int maximumBlockSize);
+    void reset();
+
+    /** Updates the detector and the frequency terms if the band moved or the design changed */
+    void setBand(float frequency, float quality, bool matchedDesign);
+
+    /**
+     Runs the detector over one sub-block of the detection signal and returns the band's gain in dB.
+     The channels are mixed down before detection.
+     */
+    float process(const float* const* detectionChannels, int numChannels, int numSamples,
+                  float staticGainDecibels, const PeakDynamicsSettings& settings);
+
+    /** Resets the detector and the envelope if a NaN or infinity got into them. Returns true if it had to */
+    bool resetIfNonFinite();
+
+    /** Writes the band's design for gainDecibels into a biquad's coefficients. Only designs again if the gain or the band changed */
+    void applyGain(juce::dsp::IIR::Coefficients<float>& coefficients, float gainDecibels);
+
+    static constexpr float MinGainDecibels = -24.f, MaxGainDecibels = 24.f;
+
+    /** Heap memory held by the detection buffer */
+    size_t getNumBytes() const
+    {
+        return (size_t) (detectionBuffer.getNumChannels() * detectionBuffer.getNumSamples()) * sizeof(float);
+    }
+
+private:
+    using Biquad = std::array<float, 5>; // b0, b1, b2, a1, a2 normalised by a0
+
+    void design(float gainDecibels);
+
+    double sampleRate = 44100.0;
+    float bandFrequency = 0.f, bandQuality = 0.f;
+    bool bandMatched = false;
+    float envelope = 0.f;
+    // The filter's state isn't accessible, but a broken state shows in every output after it
+    float lastDetectorOutput = 0.f;
+
+    // Bilinear peak terms that only depend on the frequency and Q
+    double alpha = 0.0, c2 = 0.0;
+
+    Biquad designed {};
+    float designedGainDecibels = 0.f;
+    bool designStale = true;
+
+    juce::dsp::IIR::Filter<float> detectorFilter;
+    juce::AudioBuffer<float> detectionBuffer;
+};
@@ -17,47 +17,68 @@ void LookAndFeel::drawRotarySlider(juce::Graphics &g,
     
     auto bounds = Rectangle<float>(x, y, width, height);
     
-    auto enabled = slider.isEnabled();
+    drawRotarySliderBody(g, bounds, slider.isEnabled());
 
+    if (auto* rswl = dynamic_cast<RotarySliderWithLabels*>(&slider))
+    {
+        g.setFont(rswl->getTextHeight());
+        auto text = rswl->getDisplayString();
+        
+        drawRotarySliderPointer(g, bounds, sliderPosProportional, rotaryStartAngle, rotaryEndAngle,
+                                *rswl, text, g.getCurrentFont().getStringWidth(text));
+    }
+}
+
+void LookAndFeel::drawRotarySliderBody(juce::Graphics &g, juce::Rectangle<float> bounds, bool enabled)
+{
+    using namespace juce;
+    
     g.setColour(enabled ? Colour(236u, 236u, 231u) : Colours::grey);
     g.fillEllipse(bounds);
 
     g.setColour(enabled ? Colour(54u, 69u, 79u) : Colours::grey);
     g.drawEllipse(bounds, 1.f);
+}
 
-    if (auto* rswl = dynamic_cast<RotarySliderWithLabels*>(&slider))
-    {
-        auto center = bounds.getCentre();
-        Path p;
-
-        Rectangle<float> r;
-        r.setLeft(center.getX() - 2);
-        r.setRight(center.getX() + 2);
-        r.setTop(bounds.getY());
-        r.setBottom(center.getY() - rswl->getTextHeight() * 1.5);
-
-        p.addRoundedRectangle(r, 2.f);
-
-        jassert(rotaryStartAngle < rotaryEndAngle);
+void LookAndFeel::drawRotarySliderPointer(juce::Graphics &g,
+                                          juce::Rectangle<float> bounds,
+                                          float sliderPosProportional,
+                                          float rotaryStartAngle,
+                                          float rotaryEndAngle,
+                                          const RotarySliderWithLabels &rswl,
+                                          const juce::String &valueText,
+                                          int valueTextWidth)
+{
+    using namespace juce;
+    
+    auto enabled = rswl.isEnabled();
+    auto center = bounds.getCentre();
 
-        auto sliderAngRad = jmap(sliderPosProportional, 0.f, 1.f, rotaryStartAngle, rotaryEndAngle);
-        p.applyTransform(AffineTransform().rotated(sliderAngRad, center.getX(), center.getY()));
+    Rectangle<float> r;
+    r.setLeft(center.getX() - 2);
+    r.setRight(center.getX() + 2);
+    r.setTop(bounds.getY());
+    r.setBottom(center.getY() - rswl.getTextHeight() * 1.5);
 
-        g.fillPath(p);
+    jassert(rotaryStartAngle < rotaryEndAngle);
 
-        g.setFont(rswl->getTextHeight());
-        auto text = rswl->getDisplayString();
-        auto strWidth = g.getCurrentFont().getStringWidth(text);
+    auto sliderAngRad = jmap(sliderPosProportional, 0.f, 1.f, rotaryStartAngle, rotaryEndAngle);
+    
+    {
+        /** Rotate the context rather than building a rotated Path */
+        Graphics::ScopedSaveState state(g);
+        g.addTransform(AffineTransform().rotated(sliderAngRad, center.getX(), center.getY()));
+        g.setColour(enabled ? Colour(54u, 69u, 79u) : Colours::grey);
+        g.fillRoundedRectangle(r, 2.f);
+    }
 
-        r.setSize(strWidth + 4, rswl->getTextHeight() + 2);
-        r.setCentre(bounds.getCentre());
+    g.setFont(rswl.getTextHeight());
 
-        g.setColour(Colours::transparentWhite);
-        g.fillRect(r);
+    r.setSize(valueTextWidth + 4, rswl.getTextHeight() + 2);
+    r.setCentre(bounds.getCentre());
 
-        g.setColour(enabled ? Colours::black : Colours::white);
-        g.drawFittedText(text, r.toNearestInt(), juce::Justification::centred, 1);
-    }
+    g.setColour(enabled ? Colours::black : Colours::white);
+    g.drawFittedText(valueText, r.toNearestInt(), juce::Justification::centred, 1);
 }
 
 // Add the missing function definition for the toggle button
@@ -118,21 +139,65 @@ void RotarySliderWithLabels::paint(juce::Graphics &g)
 //    g.setColour(Colours::yellow);  // Debugging slider bounds
 //    g.drawRect(sliderBounds);
 
-    getLookAndFeel().drawRotarySlider(g,
-                                      sliderBounds.getX(),
-                                      sliderBounds.getY(),
-                                      sliderBounds.getWidth(),
-                                      sliderBounds.getHeight(),
-                                      jmap(getValue(), range.getStart(), range.getEnd(), 0.0, 1.0),
-                                      startAng,
-                                      endAng,
-                                      *this);
+    COLINASEQ_PROFILE_PAINT(paintProfiler, Sliders);
+    
+    updateStaticLayer(g, startAng, endAng);
+    g.drawImageTransformed(staticLayer, AffineTransform::scale(1.f / staticLayerScale));
+    
+    g.setFont(getTextHeight());
+    
+    std::array<char, 32> text {};
+    formatDisplayString(text.data(), text.size());
+    
+    if (text != valueText || valueString.isEmpty() )
+    {
+        valueText = text;
+        valueString = String(CharPointer_UTF8(valueText.data()));
+        valueStringWidth = g.getCurrentFont().getStringWidth(valueString);
+    }
+
+    lnf.drawRotarySliderPointer(g,
+                                sliderBounds.toFloat(),
+                                jmap(getValue(), range.getStart(), range.getEnd(), 0.0, 1.0),
+                                startAng,
+                                endAng,
+                                *this,
+                                valueString,
+                                valueStringWidth);
+}
+
+void RotarySliderWithLabels::updateStaticLayer(juce::Graphics &g, float startAng, float endAng)
+{
+    using namespace juce;
+    
+    auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    auto width = roundToInt(getWidth() * scale);
+    auto height = roundToInt(getHeight() * scale);
+    
+    if (staticLayer.isValid()
+        && staticLayer.getWidth() == width
+        && staticLayer.getHeight() == height
+        && staticLayerScale == scale
+        && staticLayerEnabled == isEnabled()
+        && staticLayerNumLabels == labels.size() )
+        return;
+    
+    staticLayerScale = scale;
+    staticLayerEnabled = isEnabled();
+    staticLayerNumLabels = labels.size();
+    staticLayer = Image(Image::ARGB, jmax(1, width), jmax(1, height), true);
+    
+    Graphics lg(staticLayer);
+    lg.addTransform(AffineTransform::scale(scale));
+    
+    auto sliderBounds = getSliderBounds();
+    lnf.drawRotarySliderBody(lg, sliderBounds.toFloat(), isEnabled());
 
     auto center = sliderBounds.toFloat().getCentre();
     auto radius = sliderBounds.getWidth() * 0.5f;
 
-    g.setColour(Colours::black);
-    g.setFont(getTextHeight());
+    lg.setColour(Colours::black);
+    lg.setFont(getTextHeight());
 
     auto numChoices = labels.size();
     for (int i = 0; i < numChoices; ++i )
@@ -146,10 +211,10 @@ void RotarySliderWithLabels::paint(juce::Graphics &g)
 
         Rectangle<float> r;
         auto str = labels[i].label;
-        r.setSize(g.getCurrentFont().getStringWidth(str), getTextHeight());
+        r.setSize(lg.getCurrentFont().getStringWidth(str), getTextHeight());
         r.setCentre(c);
 
-        g.drawFittedText(str, r.toNearestInt(), juce::Justification::centred, 1);
+        lg.drawFittedText(str, r.toNearestInt(), juce::Justification::centred, 1);
     }
 }
 
@@ -172,11 +237,19 @@ juce::Rectangle<int> RotarySliderWithLabels::getSliderBounds() const   // Correc
 
 
 juce::String RotarySliderWithLabels::getDisplayString() const
+{
+    std::array<char, 32> text {};
+    formatDisplayString(text.data(), text.size());
+    
+    return juce::String(juce::CharPointer_UTF8(text.data()));
+}
+
+int RotarySliderWithLabels::formatDisplayString(char* buffer, size_t bufferSize) const
 {
     if (auto* choiceParam = dynamic_cast<juce::AudioParameterChoice*>(param) )
-        return choiceParam->getCurrentChoiceName();
+        return std::snprintf(buffer, bufferSize, "%s", choiceParam->choices[choiceParam->getIndex()].toRawUTF8());
     
-    juce::String str;
+    int length = 0;
     bool addK = false;
     
     if (auto* floatParam = dynamic_cast<juce::AudioParameterFloat*>(param) )
@@ -188,22 +261,19 @@ juce::String RotarySliderWithLabels::getDisplayString() const
             addK = true;
         }
         
-        str = juce::String(val, (addK ? 2 : 0));
+        /** %g keeps the fractional part of Q, gain, ratio and morph values, like juce::String(val) did */
+        length = std::snprintf(buffer, bufferSize, addK ? "%.2f" : "%g", val);
     }
     else {
         jassertfalse;
     }
         
-    if (suffix.isNotEmpty() )
+    if (suffix.isNotEmpty() && juce::isPositiveAndBelow(length, (int) bufferSize) )
     {
-        str << " ";
-        if (addK )
-            str << "k";
-        
-        str << suffix;
+        length += std::snprintf(buffer + length, bufferSize - (size_t) length, addK ? " k%s" : " %s", suffix.toRawUTF8());
     }
     
-    return str;
+    return juce::jmin(length, (int) bufferSize - 1);
     
     }
 
@@ -211,10 +281,12 @@ juce::String RotarySliderWithLabels::getDisplayString() const
 
 ResponseCurveComponent::ResponseCurveComponent(ColinasEQAudioProcessor& p) :
     audioProcessor(p),
-    //leftChannelFifo(&audioProcessor.leftChannelFifo)
+    analyzerFifos(audioProcessor.acquireAnalyzerFifos()),
     
-leftPathProducer(audioProcessor.leftChannelFifo),
-rightPathProducer(audioProcessor.rightChannelFifo)
+pathProducer(analyzerFifos)
+#if JUCE_MAJOR_VERSION >= 7
+, vBlankAttachment(this, [this]() { onFrame(); })
+#endif
 
 {
     const auto& params = audioProcessor.getParameters();
@@ -227,7 +299,11 @@ rightPathProducer(audioProcessor.rightChannelFifo)
     
     updateChain();
     
-    startTimerHz(60);
+    ownLevels.fill(-48.f);
+    
+#if JUCE_MAJOR_VERSION < 7
+    startTimerHz(ActiveRateHz);
+#endif
 }
 
 ResponseCurveComponent::~ResponseCurveComponent()
@@ -237,6 +313,17 @@ ResponseCurveComponent::~ResponseCurveComponent()
     {
         param->removeListener(this);
     }
+    
+    stopTimer();
+    
+    /** Drops this view's request. Other open views keep the taps if they asked for them */
+    if( pathProducer.isPrePostMode() )
+        audioProcessor.setPreEqAnalyzerEnabled(false);
+    
+    if( overlayEnabled )
+        spectrumRegistry->unsubscribe();
+    
+    audioProcessor.releaseAnalyzerFifos();
 }
 
 void ResponseCurveComponent::parameterValueChanged(int parameterIndex, float newValue)
@@ -244,53 +331,234 @@ void ResponseCurveComponent::parameterValueChanged(int parameterIndex, float new
     parametersChanged.set(true);
 }
 
-void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
+void PathProducer::setPrePostMode(bool enabled)
+{
+    if( prePostMode == enabled )
+        return;
+    
+    prePostMode = enabled;
+    
+    /** The history belongs to the other pair of signals now */
+    stereoBuffer.clear();
+    lowBandBuffer.clear();
+    lowBandData.clear();
+    lowBandDifferenceData.clear();
+    differenceTrace.clear();
+}
+
+bool PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
 {
-    juce::AudioBuffer<float> tempIncomingBuffer;
+    juce::AudioBuffer<float> tempLeftBuffer, tempRightBuffer;
+    
+    if( sampleRate > 0.0 && sampleRate != preparedSampleRate )
+    {
+        preparedSampleRate = sampleRate;
+        decimator.prepare(sampleRate);
+        lowBandBuffer.clear();
+        lowBandData.clear();
+        buffersSinceLowBand = 0;
+    }
     
-    while (leftChannelFifo->getNumCompleteBuffersAvailable() > 0)
+    const auto fftSize = fftDataGenerator.getFFTSize();
+    const auto numBins = fftSize / 2;
+    
+    /** Pre/post mode packs the mid signal before the EQ where the left channel went, and the one after it where the right went */
+    auto* firstFifo = prePostMode ? preEqFifo : leftChannelFifo;
+    auto* secondFifo = prePostMode ? postEqFifo : rightChannelFifo;
+    
+    bool newFrame = false, waterfallChanged = false;
+    
+    /** Both FIFOs are filled by the same processBlock calls, so their buffers arrive in pairs */
+    while (firstFifo->getNumCompleteBuffersAvailable() > 0
+           && secondFifo->getNumCompleteBuffersAvailable() > 0)
     {
-        if (leftChannelFifo->getAudioBuffer(tempIncomingBuffer) )
+        if (firstFifo->getAudioBuffer(tempLeftBuffer) && secondFifo->getAudioBuffer(tempRightBuffer) )
         {
-            auto size = tempIncomingBuffer.getNumSamples();
+            auto size = tempLeftBuffer.getNumSamples();
+            auto keep = stereoBuffer.getNumSamples() - size;
             
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0),
-                                              monoBuffer.getReadPointer(0, size),
-                                              monoBuffer.getNumSamples() - size);
+            juce::FloatVectorOperations::copy(stereoBuffer.getWritePointer(0, 0), stereoBuffer.getReadPointer(0, size), keep);
+            juce::FloatVectorOperations::copy(stereoBuffer.getWritePointer(1, 0), stereoBuffer.getReadPointer(1, size), keep);
             
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, monoBuffer.getNumSamples() - size), tempIncomingBuffer.getReadPointer(0,0),
-                                              size);
+            juce::FloatVectorOperations::copy(stereoBuffer.getWritePointer(0, keep), tempLeftBuffer.getReadPointer(0, 0), size);
+            juce::FloatVectorOperations::copy(stereoBuffer.getWritePointer(1, keep), tempRightBuffer.getReadPointer(0, 0), size);
             
-            leftChannelFFTDataGenerator.produceFFTDataForRendering(monoBuffer, -48.f);
+            if( decimator.isPrepared() )
+            {
+                decimator.process(tempLeftBuffer.getReadPointer(0), tempRightBuffer.getReadPointer(0), size, lowBandBuffer);
+                
+                if( ++buffersSinceLowBand >= AnalyzerDecimator::Factor )
+                {
+                    buffersSinceLowBand = 0;
+                    transformLowBand(numBins);
+                }
+            }
+            
+            /** The waterfall needs every window. The traces only ever show the newest one */
+            if (waterfall != nullptr && transformFrame(numBins))
+                waterfallChanged = true;
+            
+            newFrame = true;
         }
     }
     
-    const auto fftSize = leftChannelFFTDataGenerator.getFFTSize();
+    if (! newFrame)
+        return false;
     
-    const auto binWidth = sampleRate / (double)fftSize;
+    if (waterfall == nullptr)
+        transformFrame(numBins);
     
-    while (leftChannelFFTDataGenerator.getNumAvailableFFTDataBlocks() > 0)
+    /** Silence, or a signal that holds still, keeps producing frames that would draw the same picture */
+    auto traceChange = generateTraces(fftBounds, fftSize, (float)(sampleRate / (double)fftSize));
+    return traceChange > MinTraceChangePixels || waterfallChanged;
+}
+
+bool PathProducer::transformFrame(int numBins)
+{
+    /** Every FIFO on this thread is read straight after it is written, so none of them holds more than one item */
+    fftDataGenerator.produceFFTDataForRendering(stereoBuffer, -48.f);
+    
+    if (! fftDataGenerator.getFFTData(fftData) )
+        return false;
+    
+    /** The waterfall shows the output, which is the post-EQ mid signal in pre/post mode */
+    if (waterfall != nullptr)
+        return waterfall->pushFrame(prePostMode ? fftData.data() + numBins : fftData.data(), fftData.data() + numBins, -48.f);
+    
+    return false;
+}
+
+void PathProducer::transformLowBand(int numBins)
+{
+    lowBandGenerator.produceFFTDataForRendering(lowBandBuffer, -48.f);
+    
+    if (lowBandGenerator.getFFTData(lowBandData) && prePostMode)
     {
-        std::vector<float> fftData;
-        if (leftChannelFFTDataGenerator.getFFTData(fftData) )
-        {
-            pathProducer.generatePath(fftData, fftBounds, fftSize, binWidth, -48.f);
-        }
+        lowBandDifferenceData.resize(numBins);
+        juce::FloatVectorOperations::subtract(lowBandDifferenceData.data(), lowBandData.data() + numBins, lowBandData.data(), numBins);
     }
+}
+
+float PathProducer::generateTraces(juce::Rectangle<float> fftBounds, int fftSize, float binWidth)
+{
+    const auto numBins = fftSize / 2;
+    
+    if (fftData.size() != (size_t)fftSize)
+        return 0.f;
+    
+    /** Largest move of any column of the trace since the last frame. A trace that changed size moved everywhere */
+    auto pullTrace = [this](AnalyzerTraceGenerator& generator, std::vector<float>& trace)
+    {
+        previousTrace.assign(trace.begin(), trace.end());
+        
+        if (! generator.getTrace(trace))
+            return 0.f;
+        
+        if (trace.size() != previousTrace.size())
+            return std::numeric_limits<float>::infinity();
+        
+        auto change = 0.f;
+        
+        for (size_t i = 0; i < trace.size(); ++i)
+            change = juce::jmax(change, std::abs(trace[i] - previousTrace[i]));
+        
+        return change;
+    };
     
-    while (pathProducer.getNumPathsAvailable() )
+    /** Until the low band has produced its first frame the full rate spectrum covers everything */
+    const bool haveLowBand = lowBandData.size() == (size_t)fftSize;
+    const auto lowBandBinWidth = (float)(decimator.getOutputSampleRate() / (double)fftSize);
+    
+    AnalyzerTraceGenerator::LowBand lowBandFirst { lowBandData.data(), lowBandBinWidth, decimator.getCrossover() };
+    AnalyzerTraceGenerator::LowBand lowBandSecond { haveLowBand ? lowBandData.data() + numBins : nullptr, lowBandBinWidth, decimator.getCrossover() };
+    AnalyzerTraceGenerator::LowBand lowBandDifference { lowBandDifferenceData.data(), lowBandBinWidth, decimator.getCrossover() };
+    
+    const bool haveLowBandDifference = haveLowBand && lowBandDifferenceData.size() == (size_t)numBins;
+    
+    auto* first = fftData.data();
+    auto* second = fftData.data() + numBins;
+    
+    leftTraceGenerator.generateTrace(first, fftBounds, fftSize, binWidth, -48.f, haveLowBand ? &lowBandFirst : nullptr);
+    rightTraceGenerator.generateTrace(second, fftBounds, fftSize, binWidth, -48.f, haveLowBand ? &lowBandSecond : nullptr);
+    
+    auto change = juce::jmax(pullTrace(leftTraceGenerator, leftChannelTrace),
+                             pullTrace(rightTraceGenerator, rightChannelTrace));
+    
+    if (prePostMode)
     {
-        pathProducer.getPath(leftChannelFFTPath);
+        /** Both spectra are already in dB, so the difference is one vectorised subtraction */
+        differenceData.resize(numBins);
+        juce::FloatVectorOperations::subtract(differenceData.data(), second, first, numBins);
+        differenceTraceGenerator.generateDifferenceTrace(differenceData.data(), fftBounds, fftSize, binWidth,
+                                                         haveLowBandDifference ? &lowBandDifference : nullptr);
+        change = juce::jmax(change, pullTrace(differenceTraceGenerator, differenceTrace));
     }
+    
+    return change;
+}
+
+size_t PathProducer::getNumBytes() const
+{
+    auto bufferBytes = [](const juce::AudioBuffer<float>& b) { return (size_t)(b.getNumChannels() * b.getNumSamples()) * sizeof(float); };
+    auto vectorBytes = [](const std::vector<float>& v) { return v.capacity() * sizeof(float); };
+    
+    return sizeof(*this)
+         + bufferBytes(stereoBuffer) + bufferBytes(lowBandBuffer)
+         + fftDataGenerator.getNumBytes() + lowBandGenerator.getNumBytes()
+         + decimator.getNumBytes()
+         + leftTraceGenerator.getNumBytes() + rightTraceGenerator.getNumBytes() + differenceTraceGenerator.getNumBytes()
+         + vectorBytes(fftData) + vectorBytes(lowBandData) + vectorBytes(lowBandDifferenceData) + vectorBytes(differenceData)
+         + vectorBytes(leftChannelTrace) + vectorBytes(rightChannelTrace) + vectorBytes(differenceTrace) + vectorBytes(previousTrace);
 }
 
 void ResponseCurveComponent::timerCallback()
 {
+    onFrame();
+}
+
+void ResponseCurveComponent::onFrame()
+{
+#if JUCE_MAJOR_VERSION >= 7
+    /** The vblank callback keeps coming at the display rate, so skip frames while idle.
+        Pauses longer than 100 ms, e.g. while the window is hidden, are left out of the average */
+    auto now = juce::Time::getMillisecondCounterHiRes();
+    
+    if (lastVBlankMs > 0.0 && now - lastVBlankMs < 100.0)
+        vBlankIntervalMs += 0.1 * (juce::jmax(1.0, now - lastVBlankMs) - vBlankIntervalMs);
+    
+    lastVBlankMs = now;
+    
+    /** Rounded down, so idle polling never drops below IdleRateHz */
+    auto framesPerIdlePoll = juce::jmax(1, (int) std::floor(1000.0 / IdleRateHz / vBlankIntervalMs));
+    
+    if (idleFrames > IdleFramesBeforeSlowdown && ++skippedFrames < framesPerIdlePoll)
+        return;
+    
+    skippedFrames = 0;
+#endif
+    
     auto fftBounds = getAnalysisArea().toFloat();
     auto sampleRate = audioProcessor.getSampleRate();
     
-    leftPathProducer.process(fftBounds, sampleRate);
-    rightPathProducer.process(fftBounds, sampleRate);
+    bool needsRepaint = false;
+    
+    /** New analyzer frames only touch the analysis area */
+    bool newAnalyzerFrame = pathProducer.process(fftBounds, sampleRate);
+    
+    /** The other instances keep publishing while this one has nothing new */
+    if( overlayEnabled && updateOverlay(fftBounds) )
+        newAnalyzerFrame = true;
+    
+    if( newAnalyzerFrame )
+        analyzerLayerDirty = true;
+    
+    /** Storing a snapshot changes the morphed response without touching a parameter */
+    auto bankVersion = audioProcessor.snapshotBank.getVersion();
+    if( bankVersion != snapshotBankVersion )
+    {
+        snapshotBankVersion = bankVersion;
+        parametersChanged.set(true);
+    }
     
     if( parametersChanged.compareAndSetBool(false, true) )
     {
@@ -298,16 +566,30 @@ void ResponseCurveComponent::timerCallback()
         //update the monochain
         updateChain();
         //signal a repaint
-        //repaint();
+        responseLayerDirty = true;
+        needsRepaint = true;
     }
     
-    repaint();
-
+    if( needsRepaint )
+        repaint();
+    else if( newAnalyzerFrame )
+        repaint(getAnalysisArea());
+    
+    if( needsRepaint || newAnalyzerFrame )
+        idleFrames = 0;
+    else
+        ++idleFrames;
+    
+#if JUCE_MAJOR_VERSION < 7
+    auto rateHz = idleFrames > IdleFramesBeforeSlowdown ? IdleRateHz : ActiveRateHz;
+    if( getTimerInterval() != 1000 / rateHz )
+        startTimerHz(rateHz);
+#endif
 }
 
 void ResponseCurveComponent::updateChain()
 {
-    auto chainSettings = getChainSettings(audioProcessor.apvts);
+    auto chainSettings = audioProcessor.getEffectiveChainSettings();
     
     monoChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
     monoChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
@@ -315,14 +597,16 @@ void ResponseCurveComponent::updateChain()
 
 
     
-    auto peakCoefficients = makePeakFilter(chainSettings, audioProcessor.getSampleRate());
-    updateCoefficients(monoChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    auto sampleRate = audioProcessor.getSampleRate();
+    
+    auto peakCoefficients = getPeakCoefficients(*coefficientCache, chainSettings, sampleRate);
+    updateCoefficients(monoChain.get<ChainPositions::Peak>().coefficients, (*peakCoefficients)[0]);
     
-    auto lowCutCoefficients = makeLowCutFilter(chainSettings, audioProcessor.getSampleRate());
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, audioProcessor.getSampleRate());
+    auto lowCutCoefficients = getLowCutCoefficients(*coefficientCache, chainSettings, sampleRate);
+    auto highCutCoefficients = getHighCutCoefficients(*coefficientCache, chainSettings, sampleRate);
     
-    updateCutFilter(monoChain.get<ChainPositions::LowCut>(), lowCutCoefficients, chainSettings.lowCutSlope);
-    updateCutFilter(monoChain.get<ChainPositions::HighCut>(), highCutCoefficients, chainSettings.highCutSlope);
+    updateCutFilter(monoChain.get<ChainPositions::LowCut>(), *lowCutCoefficients, chainSettings.lowCutSlope);
+    updateCutFilter(monoChain.get<ChainPositions::HighCut>(), *highCutCoefficients, chainSettings.highCutSlope);
     
 }
 
@@ -333,64 +617,254 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
    // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll (Colours::black);
     
-    g.drawImage(background, getLocalBounds().toFloat());
+    auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    auto toLogical = AffineTransform::scale(1.f / scale);
+    
+    /** Every layer is cached at physical resolution, so these blits map 1:1 onto the screen */
+    {
+        COLINASEQ_PROFILE_PAINT(paintProfiler, Grid);
+        updateBackground(scale);
+        g.drawImageTransformed(background, toLogical);
+    }
+    
+    auto analysisArea = getAnalysisArea();
+    
+    if( waterfallEnabled )
+    {
+        COLINASEQ_PROFILE_PAINT(paintProfiler, Analyzer);
+        waterfall.prepare(roundToInt(analysisArea.getWidth() * scale),
+                          roundToInt(analysisArea.getHeight() * scale),
+                          pathProducer.getFFTSize(),
+                          audioProcessor.getSampleRate());
+        waterfall.draw(g, analysisArea, scale);
+    }
+    else
+    {
+        COLINASEQ_PROFILE_PAINT(paintProfiler, Analyzer);
+        updateAnalyzerLayer(scale);
+        g.drawImageTransformed(analyzerLayer, toLogical.translated(analysisArea.getX(), analysisArea.getY()));
+    }
+    
+    {
+        COLINASEQ_PROFILE_PAINT(paintProfiler, ResponseCurve);
+        updateResponseLayer(scale);
+        g.drawImageTransformed(responseLayer, toLogical);
+    }
+}
+
+void ResponseCurveComponent::setWaterfallEnabled(bool enabled)
+{
+    waterfallEnabled = enabled;
+    pathProducer.setWaterfall(enabled ? &waterfall : nullptr);
+    
+    /** The traces kept updating underneath, but the layer was not redrawn while hidden */
+    analyzerLayerDirty = true;
+    idleFrames = 0;
+    repaint();
+}
+
+void ResponseCurveComponent::setPrePostEnabled(bool enabled)
+{
+    /** The processor counts requests, so only pass on changes to this view's own */
+    if( pathProducer.isPrePostMode() != enabled )
+        audioProcessor.setPreEqAnalyzerEnabled(enabled);
+    
+    pathProducer.setPrePostMode(enabled);
+    
+    analyzerLayerDirty = true;
+    idleFrames = 0;
+    repaint();
+}
+
+void ResponseCurveComponent::setOverlayEnabled(bool enabled)
+{
+    if( overlayEnabled == enabled )
+        return;
+    
+    overlayEnabled = enabled;
+    
+    if( enabled )
+        spectrumRegistry->subscribe();
+    else
+        spectrumRegistry->unsubscribe();
+    
+    numOtherTraces = 0;
+    maskedBands.fill(false);
+    analyzerLayerDirty = true;
+    idleFrames = 0;
+    repaint();
+}
 
+bool ResponseCurveComponent::updateOverlay(juce::Rectangle<float> fftBounds)
+{
+    using namespace juce;
+    
+    auto width = jmax(1, (int)fftBounds.getWidth());
+    auto top = fftBounds.getY();
+    auto bottom = fftBounds.getHeight();
+    
+    /** Same mapping as the analyzer traces */
+    auto map = [bottom, top](float v) { return jmap(v, -48.f, 0.f, bottom + 10.f, top); };
+    
+    const auto previousNumOthers = numOtherTraces;
+    numOtherTraces = 0;
+    maskedBands.fill(false);
+    
+    /** This instance's processor publishes too while the overlay is on, so masking compares the same kind of spectrum */
+    const auto ownSlot = audioProcessor.getSpectrumSlot();
+    
+    if( ownSlot < 0 || ! spectrumRegistry->read(ownSlot, ownLevels) )
+        ownLevels.fill(-48.f);
+    
+    for( int slot = 0; slot < SpectrumRegistry::MaxSlots; ++slot )
+    {
+        if( slot == ownSlot || ! spectrumRegistry->read(slot, otherLevels) )
+            continue;
+        
+        if( otherTraces.size() <= numOtherTraces )
+            otherTraces.emplace_back();
+        
+        auto& trace = otherTraces[numOtherTraces++];
+        trace.resize((size_t)width);
+        
+        /** Bands are spaced evenly on the same log axis as the columns */
+        for( int x = 0; x < width; ++x )
+        {
+            auto position = (float)x / (float)jmax(1, width - 1) * (SpectrumRegistry::NumBands - 1);
+            auto band = jmin((int)position, SpectrumRegistry::NumBands - 2);
+            auto frac = position - (float)band;
+            auto level = otherLevels[(size_t)band] + (otherLevels[(size_t)band + 1] - otherLevels[(size_t)band]) * frac;
+            
+            trace[(size_t)x] = map(jmax(level, -48.f));
+        }
+        
+        for( size_t band = 0; band < maskedBands.size(); ++band )
+            if( ownLevels[band] > MaskingThresholdDecibels && otherLevels[band] > MaskingThresholdDecibels )
+                maskedBands[band] = true;
+    }
+    
+    return numOtherTraces > 0 || previousNumOthers > 0;
+}
+
+void ResponseCurveComponent::addMemoryFootprint(MemoryFootprint& footprint) const
+{
+    auto imageBytes = [](const juce::Image& image) { return (size_t)(image.getWidth() * image.getHeight()) * 4; };
+    
+    footprint.analyzerPipeline += pathProducer.getNumBytes();
+    footprint.displayLayers += imageBytes(background) + imageBytes(analyzerLayer) + imageBytes(responseLayer)
+                             + waterfall.getNumBytes();
+}
+
+void ResponseCurveComponent::updateAnalyzerLayer(float scale)
+{
+    using namespace juce;
+    
+    auto area = getAnalysisArea();
+    auto width = jmax(1, roundToInt(area.getWidth() * scale));
+    auto height = jmax(1, roundToInt(area.getHeight() * scale));
+    
+    if( ! analyzerLayer.isValid() || analyzerLayer.getWidth() != width || analyzerLayer.getHeight() != height )
+    {
+        analyzerLayer = Image(Image::ARGB, width, height, true);
+        analyzerRenderer.reset();
+        analyzerLayerDirty = true;
+    }
+    
+    if( ! analyzerLayerDirty )
+        return;
+    
+    analyzerLayerDirty = false;
+    
+    /** The traces are already relative to the analysis area */
+    analyzerRenderer.beginFrame(analyzerLayer);
+    
+    if( overlayEnabled )
+    {
+        /** The masking highlights are not tracked by the renderer, so start from a clear layer */
+        analyzerLayer.clear(analyzerLayer.getBounds());
+        analyzerRenderer.reset();
+        
+        {
+            Graphics g(analyzerLayer);
+            g.addTransform(AffineTransform::scale(scale));
+            g.setColour(Colours::red.withAlpha(0.25f));
+            
+            auto bandWidth = (float)area.getWidth() / (float)(SpectrumRegistry::NumBands - 1);
+            
+            for( int band = 0; band < SpectrumRegistry::NumBands; ++band )
+            {
+                if( ! maskedBands[(size_t)band] )
+                    continue;
+                
+                auto first = band;
+                while( band + 1 < SpectrumRegistry::NumBands && maskedBands[(size_t)band + 1] )
+                    ++band;
+                
+                g.fillRect(Rectangle<float>(((float)first - 0.5f) * bandWidth, 0.f,
+                                            (float)(band - first + 1) * bandWidth, (float)area.getHeight()));
+            }
+        }
+        
+        for( size_t i = 0; i < numOtherTraces; ++i )
+            analyzerRenderer.drawTrace(analyzerLayer, otherTraces[i], scale, {}, 1.5f, Colours::skyblue.withAlpha(0.6f));
+    }
+    
+    if( pathProducer.isPrePostMode() )
+    {
+        /** Input dimmed behind the output, and the difference on the response curve's scale so the two can be compared */
+        analyzerRenderer.drawTrace(analyzerLayer, pathProducer.getLeftTrace(), scale, {}, 2.f, Colours::grey);
+        analyzerRenderer.drawTrace(analyzerLayer, pathProducer.getRightTrace(), scale, {}, 3.f, Colours::orange);
+        analyzerRenderer.drawTrace(analyzerLayer, pathProducer.getDifferenceTrace(), scale, {}, 2.f, Colours::lightgreen);
+        return;
+    }
+    
+    analyzerRenderer.drawTrace(analyzerLayer, pathProducer.getLeftTrace(), scale, {}, 3.f, Colours::orange); // Spectrum Analyzer Colour
+    analyzerRenderer.drawTrace(analyzerLayer, pathProducer.getRightTrace(), scale, {}, 3.f, Colours::yellow); // Spectrum Analyzer Colour
+}
+
+void ResponseCurveComponent::updateResponseLayer(float scale)
+{
+    using namespace juce;
+    
+    auto width = jmax(1, roundToInt(getWidth() * scale));
+    auto height = jmax(1, roundToInt(getHeight() * scale));
+    
+    if( ! responseLayer.isValid() || responseLayer.getWidth() != width || responseLayer.getHeight() != height )
+    {
+        responseLayer = Image(Image::ARGB, width, height, true);
+        responseRenderer.reset();
+        responseLayerDirty = true;
+    }
+    
+    if( ! responseLayerDirty )
+        return;
+    
+    responseLayerDirty = false;
+    responseLayer.clear(responseLayer.getBounds());
+    responseRenderer.reset();
+    
     auto responseArea = getAnalysisArea();
     
     auto w = responseArea.getWidth();
 
-    auto& lowcut = monoChain.get<ChainPositions::LowCut>();
-    auto& peak = monoChain.get<ChainPositions::Peak>();
-    auto& highcut = monoChain.get<ChainPositions::HighCut>();
 
     auto sampleRate = audioProcessor.getSampleRate();
 
-    std::vector<double> mags;
+    std::vector<float> mags;
 
     mags.resize(w);
 
 
    for( int i = 0; i < w; ++i)
    {
-       double mag = 1.f;
        auto freq = mapToLog10(double(i) / double(w),20.0, 20000.0);
        
-       if(! monoChain.isBypassed<ChainPositions::Peak>() )
-           mag *= peak.coefficients->getMagnitudeForFrequency(freq, sampleRate);
-       
-       if( !monoChain.isBypassed<ChainPositions::LowCut>() )
-       {
-           if(! lowcut.isBypassed<0>() )
-               mag *= lowcut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-           if(! lowcut.isBypassed<1>() )
-               mag *= lowcut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-           if(! lowcut.isBypassed<2>() )
-               mag *= lowcut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-           if(! lowcut.isBypassed<3>() )
-               mag *= lowcut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-       }
+       /** The same evaluation the processor's auto gain integrates */
+       auto mag = getChainMagnitudeForFrequency(monoChain, freq, sampleRate);
        
-       
-       
-       if( !monoChain.isBypassed<ChainPositions::HighCut>() )
-       {
-           if(! highcut.isBypassed<0>() )
-               mag *= highcut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-           if(! highcut.isBypassed<1>() )
-               mag *= highcut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-           if(! highcut.isBypassed<2>() )
-               mag *= highcut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-           if(! highcut.isBypassed<3>() )
-               mag *= highcut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-       }
-       
-       
-       
-       mags[i] =  Decibels::gainToDecibels(mag);
+       mags[i] = (float) Decibels::gainToDecibels(mag);
 
    }
-   Path responseCurve;
-   
    const double outputMin = responseArea.getBottom();
    const double outputMax = responseArea.getY();
    auto map = [outputMin, outputMax] ( double input)
@@ -398,42 +872,45 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
        return jmap(input, -24.0, 24.0, outputMin, outputMax);
    };
    
-   responseCurve.startNewSubPath(responseArea.getX(), map(mags.front()));
-   
-   for( size_t i = 1; i < mags.size(); ++i)
-   {
-       responseCurve.lineTo(responseArea.getX() + i, map(mags[i]));
-   }
-    
-    auto leftChannelFFTPath = leftPathProducer.getPath();
-    
-    leftChannelFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY()));
-    
-    g.setColour(Colours::orange); // Spectrum Analyzer Colour
-    g.strokePath(leftChannelFFTPath, PathStrokeType(3.f));
+   for( auto& m : mags )
+       m = (float) map(m);
     
-    auto rightChannelFFTPath = rightPathProducer.getPath();
-    rightChannelFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY()));
+    {
+        Graphics g(responseLayer);
+        g.addTransform(AffineTransform::scale(scale));
+        g.setColour(Colours::lightblue);
+        g.drawRoundedRectangle(getRenderArea().toFloat(), 8.f, 4.f);//Size of the Rectangle of the response curve
+    }
     
-    g.setColour(Colours::yellow); // Spectrum Analyzer Colour
-    g.strokePath(rightChannelFFTPath, PathStrokeType(3.f));
+    responseRenderer.drawTrace(responseLayer, mags, scale, { (float) responseArea.getX(), 0.f }, 4.f, Colours::lightblue);//Size of the response curve
+}
 
+void ResponseCurveComponent::resized()
+{
+    using namespace juce;
     
-    
-    g.setColour(Colours::lightblue);
-    g.drawRoundedRectangle(getRenderArea().toFloat(), 8.f, 4.f);//Size of the Rectangle of the response curve
-   
-    g.setColour(Colours::lightblue);
-    g.strokePath(responseCurve, PathStrokeType(4.f));//Size of the response curve
-   
+    /** Resizing repaints by itself. Poll at the full rate again so the analyzer catches up with the new size */
+    idleFrames = 0;
 }
 
-void ResponseCurveComponent::resized()
+void ResponseCurveComponent::updateBackground(float scale)
 {
     using namespace juce;
-    background = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
+    
+    auto width = roundToInt(getWidth() * scale);
+    auto height = roundToInt(getHeight() * scale);
+    
+    if( background.isValid()
+        && background.getWidth() == width
+        && background.getHeight() == height
+        && backgroundScale == scale )
+        return;
+    
+    backgroundScale = scale;
+    background = Image(Image::PixelFormat::RGB, jmax(1, width), jmax(1, height), true);
     
     Graphics g(background);
+    g.addTransform(AffineTransform::scale(scale));
     
     Array<float> freqs
     {
@@ -580,34 +1057,143 @@ juce::Rectangle<int> ResponseCurveComponent::getAnalysisArea()
 
 
 
+//==============================================================================
+LevelMeterComponent::LevelMeterComponent(LevelMeter& meterToShow, const juce::String& labelText)
+    : meter(meterToShow), label(labelText)
+{
+    startTimerHz(RefreshRateHz);
+}
+
+void LevelMeterComponent::timerCallback()
+{
+    using namespace juce;
+    
+    const auto previousReading = reading;
+    const auto previousPeakDecibels = peakDecibels;
+    const auto previousTruePeakHold = truePeakHoldDecibels;
+    
+    reading = meter.read();
+    
+    for( size_t ch = 0; ch < peakDecibels.size(); ++ch )
+    {
+        auto peak = Decibels::gainToDecibels(reading.samplePeak[ch], -100.f);
+        peakDecibels[ch] = jmax(peak, peakDecibels[ch] - PeakDecayDecibels);
+        truePeakHoldDecibels = jmax(truePeakHoldDecibels, Decibels::gainToDecibels(reading.truePeak[ch], -100.f));
+    }
+    
+    /** With the host stopped the readings hold and the peaks settle at the floor, so the meter goes idle with the rest of the editor */
+    if( peakDecibels != previousPeakDecibels
+       || truePeakHoldDecibels != previousTruePeakHold
+       || reading.rms != previousReading.rms
+       || reading.shortTermLoudness != previousReading.shortTermLoudness
+       || reading.numChannels != previousReading.numChannels )
+    {
+        repaint();
+    }
+}
+
+void LevelMeterComponent::mouseDown(const juce::MouseEvent&)
+{
+    truePeakHoldDecibels = -100.f;
+    repaint();
+}
+
+void LevelMeterComponent::paint(juce::Graphics& g)
+{
+    using namespace juce;
+    
+    auto bounds = getLocalBounds().toFloat();
+    
+    g.setColour(Colours::white);
+    g.setFont(12.f);
+    g.drawFittedText(label, bounds.removeFromLeft(28.f).toNearestInt(), Justification::centredLeft, 1);
+    
+    auto textArea = bounds.removeFromRight(160.f);
+    
+    auto toX = [bounds](float decibels)
+    {
+        return jmap(jlimit(MinDecibels, MaxDecibels, decibels), MinDecibels, MaxDecibels, bounds.getX(), bounds.getRight());
+    };
+    
+    /** RMS as the bar, the decaying sample peak as a marker */
+    auto numChannels = jlimit(1, LevelMeter::MaxChannels, reading.numChannels);
+    auto barHeight = bounds.getHeight() / (float) numChannels;
+    
+    for( int ch = 0; ch < numChannels; ++ch )
+    {
+        auto bar = bounds.withY(bounds.getY() + barHeight * (float) ch).withHeight(barHeight).reduced(0.f, 1.f);
+        auto rmsDecibels = Decibels::gainToDecibels(reading.rms[(size_t) ch], -100.f);
+        auto peak = peakDecibels[(size_t) ch];
+        
+        g.setColour(Colours::darkgrey.darker());
+        g.fillRect(bar);
+        
+        g.setColour(Colours::green);
+        g.fillRect(bar.withRight(toX(rmsDecibels)));
+        
+        g.setColour(peak > 0.f ? Colours::red : Colours::lightgreen);
+        g.fillRect(Rectangle<float>(toX(peak) - 1.f, bar.getY(), 2.f, bar.getHeight()));
+    }
+    
+    g.setColour(Colours::white.withAlpha(0.5f));
+    g.drawVerticalLine(roundToInt(toX(0.f)), bounds.getY(), bounds.getBottom());
+    
+    String text;
+    text << "TP " << String(truePeakHoldDecibels, 1) << "  S " << String(reading.shortTermLoudness, 1) << " LUFS";
+    
+    g.setColour(truePeakHoldDecibels > 0.f ? Colours::red : Colours::white);
+    g.drawFittedText(text, textArea.toNearestInt(), Justification::centredRight, 1);
+}
+
 //==============================================================================
     ColinasEQAudioProcessorEditor::ColinasEQAudioProcessorEditor (ColinasEQAudioProcessor& p)
     : AudioProcessorEditor (&p), audioProcessor (p),
 
 
-    peakFreqSlider(*audioProcessor.apvts.getParameter("Peak Freq"),"Hz"),
-    peakGainSlider(*audioProcessor.apvts.getParameter("Peak Gain"), "dB"),
-    peakQualitySlider(*audioProcessor.apvts.getParameter("Peak Quality"),""),
-    lowCutFreqSlider(*audioProcessor.apvts.getParameter("LowCut Freq"), "Hz"),
-    highCutFreqSlider(*audioProcessor.apvts.getParameter("HighCut Freq"), "Hz"),
-    lowCutSlopeSlider(*audioProcessor.apvts.getParameter("LowCut Slope"), "dB/Oct"),
-    highCutSlopeSlider(*audioProcessor.apvts.getParameter("HighCut Slope"), "dB/Oct"),
+    peakFreqSlider(*audioProcessor.apvts.getParameter(Params::ids[Params::PeakFreq]),"Hz"),
+    peakGainSlider(*audioProcessor.apvts.getParameter(Params::ids[Params::PeakGain]), "dB"),
+    peakQualitySlider(*audioProcessor.apvts.getParameter(Params::ids[Params::PeakQuality]),""),
+    lowCutFreqSlider(*audioProcessor.apvts.getParameter(Params::ids[Params::LowCutFreq]), "Hz"),
+    highCutFreqSlider(*audioProcessor.apvts.getParameter(Params::ids[Params::HighCutFreq]), "Hz"),
+    lowCutSlopeSlider(*audioProcessor.apvts.getParameter(Params::ids[Params::LowCutSlope]), "dB/Oct"),
+    highCutSlopeSlider(*audioProcessor.apvts.getParameter(Params::ids[Params::HighCutSlope]), "dB/Oct"),
 
     responseCurveComponent(audioProcessor),
-    peakFreqSliderAttachment(audioProcessor.apvts, "Peak Freq", peakFreqSlider),
-    peakGainSliderAttachment(audioProcessor.apvts, "Peak Gain", peakGainSlider),
-    peakQualitySliderAttachment(audioProcessor.apvts, "Peak Quality", peakQualitySlider),
-    lowCutFreqSliderAttachment(audioProcessor.apvts, "LowCut Freq", lowCutFreqSlider),
-    highCutFreqSliderAttachment(audioProcessor.apvts, "HighCut Freq", highCutFreqSlider),
-    lowCutSlopeSliderAttachment(audioProcessor.apvts, "LowCut Slope", lowCutSlopeSlider),
-    highCutSlopeSliderAttachment(audioProcessor.apvts, "HighCut Slope", highCutSlopeSlider),
+    peakFreqSliderAttachment(audioProcessor.apvts, Params::ids[Params::PeakFreq], peakFreqSlider),
+    peakGainSliderAttachment(audioProcessor.apvts, Params::ids[Params::PeakGain], peakGainSlider),
+    peakQualitySliderAttachment(audioProcessor.apvts, Params::ids[Params::PeakQuality], peakQualitySlider),
+    lowCutFreqSliderAttachment(audioProcessor.apvts, Params::ids[Params::LowCutFreq], lowCutFreqSlider),
+    highCutFreqSliderAttachment(audioProcessor.apvts, Params::ids[Params::HighCutFreq], highCutFreqSlider),
+    lowCutSlopeSliderAttachment(audioProcessor.apvts, Params::ids[Params::LowCutSlope], lowCutSlopeSlider),
+    highCutSlopeSliderAttachment(audioProcessor.apvts, Params::ids[Params::HighCutSlope], highCutSlopeSlider),
     
 
 
-    lowcutBypassButtonAttachment(audioProcessor.apvts, "LowCut Bypassed",lowcutBypassButton),
-    peakBypassButtonAttachment(audioProcessor.apvts,"Peak Bypassed", peakBypassButton),
-    highcutBypassButtonAttachment(audioProcessor.apvts, "HighCut Bypassed",highcutBypassButton),
-    analyzerEnabledButtonAttachment(audioProcessor.apvts, "Analyzer Enabled",analyzerEnabledButton)
+    lowcutBypassButtonAttachment(audioProcessor.apvts, Params::ids[Params::LowCutBypassed],lowcutBypassButton),
+    peakBypassButtonAttachment(audioProcessor.apvts,Params::ids[Params::PeakBypassed], peakBypassButton),
+    highcutBypassButtonAttachment(audioProcessor.apvts, Params::ids[Params::HighCutBypassed],highcutBypassButton),
+    analyzerEnabledButtonAttachment(audioProcessor.apvts, Params::ids[Params::AnalyzerEnabled],analyzerEnabledButton),
+    
+    morphSliderAttachment(audioProcessor.apvts, Params::ids[Params::Morph], morphSlider),
+    morphEnabledButtonAttachment(audioProcessor.apvts, Params::ids[Params::MorphEnabled], morphEnabledButton),
+    
+    peakThresholdSlider(*audioProcessor.apvts.getParameter(Params::ids[Params::PeakThreshold]), "dB"),
+    peakRatioSlider(*audioProcessor.apvts.getParameter(Params::ids[Params::PeakRatio]), ""),
+    peakAttackSlider(*audioProcessor.apvts.getParameter(Params::ids[Params::PeakAttack]), "ms"),
+    peakReleaseSlider(*audioProcessor.apvts.getParameter(Params::ids[Params::PeakRelease]), "ms"),
+    
+    peakThresholdSliderAttachment(audioProcessor.apvts, Params::ids[Params::PeakThreshold], peakThresholdSlider),
+    peakRatioSliderAttachment(audioProcessor.apvts, Params::ids[Params::PeakRatio], peakRatioSlider),
+    peakAttackSliderAttachment(audioProcessor.apvts, Params::ids[Params::PeakAttack], peakAttackSlider),
+    peakReleaseSliderAttachment(audioProcessor.apvts, Params::ids[Params::PeakRelease], peakReleaseSlider),
+    
+    peakDynamicButtonAttachment(audioProcessor.apvts, Params::ids[Params::PeakDynamic], peakDynamicButton),
+    peakSidechainButtonAttachment(audioProcessor.apvts, Params::ids[Params::PeakSidechain], peakSidechainButton),
+    
+    autoGainButtonAttachment(audioProcessor.apvts, Params::ids[Params::AutoGain], autoGainButton),
+    
+    inputMeterComponent(audioProcessor.getInputMeter(), "In"),
+    outputMeterComponent(audioProcessor.getOutputMeter(), "Out")
 
 {
     
@@ -631,6 +1217,18 @@ juce::Rectangle<int> ResponseCurveComponent::getAnalysisArea()
         
         highCutSlopeSlider.labels.add({0.0f, "12"});
         highCutSlopeSlider.labels.add({1.f, "48"});
+        
+        peakThresholdSlider.labels.add({0.f, "-60dB"});
+        peakThresholdSlider.labels.add({1.f, "0dB"});
+        
+        peakRatioSlider.labels.add({0.f, "1:1"});
+        peakRatioSlider.labels.add({1.f, "20:1"});
+        
+        peakAttackSlider.labels.add({0.f, "0.1ms"});
+        peakAttackSlider.labels.add({1.f, "100ms"});
+        
+        peakReleaseSlider.labels.add({0.f, "5ms"});
+        peakReleaseSlider.labels.add({1.f, "1s"});
     
     for( auto* comp : getComps() )
     {
@@ -676,12 +1274,78 @@ juce::Rectangle<int> ResponseCurveComponent::getAnalysisArea()
         }
     };
     
-    setSize (800, 600);
+    for( int slot = 0; slot < SnapshotBank::NumSlots; ++slot )
+        snapshotSlotBox.addItem("Slot " + juce::String(slot + 1), slot + 1);
+    
+    snapshotSlotBox.setSelectedId(1, juce::dontSendNotification);
+    
+    auto storeSnapshot = [safePtr](SnapshotBank::Snapshot target)
+    {
+        if (auto* comp = safePtr.getComponent() )
+        {
+            auto& processor = comp->audioProcessor;
+            processor.snapshotBank.store(target, processor.parameterBindings.getChainSettings());
+        }
+    };
+    
+    storeAButton.onClick = [storeSnapshot]() { storeSnapshot(SnapshotBank::A); };
+    storeBButton.onClick = [storeSnapshot]() { storeSnapshot(SnapshotBank::B); };
+    
+    saveSlotButton.onClick = [safePtr]()
+    {
+        if (auto* comp = safePtr.getComponent() )
+        {
+            auto& processor = comp->audioProcessor;
+            processor.snapshotBank.storeSlot(comp->snapshotSlotBox.getSelectedId() - 1, processor.parameterBindings.getChainSettings());
+        }
+    };
+    
+    auto recallSlot = [safePtr](SnapshotBank::Snapshot target)
+    {
+        if (auto* comp = safePtr.getComponent() )
+            comp->audioProcessor.snapshotBank.recallSlot(comp->snapshotSlotBox.getSelectedId() - 1, target);
+    };
+    
+    slotToAButton.onClick = [recallSlot]() { recallSlot(SnapshotBank::A); };
+    slotToBButton.onClick = [recallSlot]() { recallSlot(SnapshotBank::B); };
+    
+    if (auto* designParameter = dynamic_cast<juce::AudioParameterChoice*>(audioProcessor.apvts.getParameter(Params::ids[Params::FilterDesign])))
+        filterDesignBox.addItemList(designParameter->choices, 1);
+    
+    filterDesignBoxAttachment = std::make_unique<APVTS::ComboBoxAttachment>(audioProcessor.apvts, Params::ids[Params::FilterDesign], filterDesignBox);
+    
+    waterfallButton.onClick = [safePtr]()
+    {
+        if (auto* comp = safePtr.getComponent() )
+            comp->responseCurveComponent.setWaterfallEnabled(comp->waterfallButton.getToggleState());
+    };
+    
+    matchButton.onClick = [safePtr]()
+    {
+        if (auto* comp = safePtr.getComponent() )
+            comp->chooseMatchFiles();
+    };
+    
+    overlayButton.onClick = [safePtr]()
+    {
+        if (auto* comp = safePtr.getComponent() )
+            comp->responseCurveComponent.setOverlayEnabled(comp->overlayButton.getToggleState());
+    };
+    
+    prePostButton.onClick = [safePtr]()
+    {
+        if (auto* comp = safePtr.getComponent() )
+            comp->responseCurveComponent.setPrePostEnabled(comp->prePostButton.getToggleState());
+    };
+    
+    audioProcessor.setMeteringEnabled(true);
+    
+    setSize (800, 700);
 }
 
 ColinasEQAudioProcessorEditor::~ColinasEQAudioProcessorEditor()
 {
- 
+    audioProcessor.setMeteringEnabled(false);
 }
 
 //==============================================================================
@@ -714,6 +1378,143 @@ ColinasEQAudioProcessorEditor::~ColinasEQAudioProcessorEditor()
      
 }
 
+MemoryFootprint ColinasEQAudioProcessorEditor::getMemoryFootprint()
+{
+    auto footprint = audioProcessor.getMemoryFootprint();
+    responseCurveComponent.addMemoryFootprint(footprint);
+    return footprint;
+}
+
+#if COLINASEQ_ENABLE_PAINT_PROFILING
+juce::String ColinasEQAudioProcessorEditor::runPaintBenchmark(const std::vector<juce::Point<int>>& sizes,
+                                                              const std::vector<float>& scales,
+                                                              int framesPerConfiguration)
+{
+    using namespace juce;
+    
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    
+    audioProcessor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+    audioProcessor.prepareToPlay(sampleRate, blockSize);
+    
+    AudioBuffer<float> buffer(jmax(audioProcessor.getTotalNumInputChannels(), audioProcessor.getTotalNumOutputChannels()), blockSize);
+    MidiBuffer midi;
+    Random random(1);
+    
+    /** About one display frame of audio at 60 Hz, so the analyzer has a new frame every time */
+    const auto blocksPerFrame = jmax(1, roundToInt(sampleRate / 60.0 / blockSize));
+    
+    String report;
+    
+    for( auto size : sizes )
+    {
+        setSize(size.x, size.y);
+        
+        for( auto scale : scales )
+        {
+            Image image(Image::ARGB, roundToInt((float) size.x * scale), roundToInt((float) size.y * scale), true, SoftwareImageType());
+            paintProfiler->reset();
+            
+            for( int frame = 0; frame < framesPerConfiguration; ++frame )
+            {
+                for( int block = 0; block < blocksPerFrame; ++block )
+                {
+                    for( int ch = 0; ch < buffer.getNumChannels(); ++ch )
+                        for( int i = 0; i < blockSize; ++i )
+                            buffer.setSample(ch, i, (random.nextFloat() * 2.f - 1.f) * 0.25f);
+                    
+                    audioProcessor.processBlock(buffer, midi);
+                }
+                
+                responseCurveComponent.timerCallback();
+                
+                {
+                    Graphics g(image);
+                    g.addTransform(AffineTransform::scale(scale));
+                    
+                    COLINASEQ_PROFILE_PAINT(paintProfiler, Total);
+                    paintEntireComponent(g, true);
+                }
+                
+                paintProfiler->endFrame();
+            }
+            
+            report << size.x << "x" << size.y << " @ " << String(scale, 2) << "x\n" << paintProfiler->getReport() << "\n";
+        }
+    }
+    
+    audioProcessor.releaseResources();
+    return report;
+}
+#endif
+
+void ColinasEQAudioProcessorEditor::chooseMatchFiles()
+{
+    using namespace juce;
+
+    const auto flags = FileBrowserComponent::openMode | FileBrowserComponent::canSelectFiles;
+    const String wildcard = "*.wav;*.aif;*.aiff;*.flac;*.ogg;*.mp3";
+    Component::SafePointer<ColinasEQAudioProcessorEditor> safePtr(this);
+
+    referenceChooser = std::make_unique<FileChooser>("Choose the reference track", File(), wildcard);
+    referenceChooser->launchAsync(flags, [safePtr, flags, wildcard](const FileChooser& chooser)
+    {
+        auto reference = chooser.getResult();
+        auto* comp = safePtr.getComponent();
+
+        if (comp == nullptr || reference == File())
+            return;
+
+        /** A second chooser, rather than replacing the one whose callback this is */
+        comp->targetChooser = std::make_unique<FileChooser>("Choose the track to EQ", reference.getParentDirectory(), wildcard);
+        comp->targetChooser->launchAsync(flags, [safePtr, reference](const FileChooser& targetChooser)
+        {
+            auto target = targetChooser.getResult();
+
+            if (auto* editor = safePtr.getComponent(); editor != nullptr && target != File())
+                editor->startMatch(reference, target);
+        });
+    });
+}
+
+void ColinasEQAudioProcessorEditor::startMatch(const juce::File& reference, const juce::File& target)
+{
+    using namespace juce;
+
+    if (matchEQ == nullptr)
+        matchEQ = std::make_unique<MatchEQ>();
+
+    if (matchEQ->isRunning())
+        return;
+
+    matchButton.setEnabled(false);
+    matchButton.setButtonText("Matching...");
+
+    /** The bands are fitted with the design and sample rate they will actually run at */
+    auto designMode = audioProcessor.getEffectiveChainSettings().designMode;
+    Component::SafePointer<ColinasEQAudioProcessorEditor> safePtr(this);
+
+    matchEQ->start(reference, target, audioProcessor.getSampleRate(), designMode, [safePtr](const MatchEQ::Result& result)
+    {
+        auto* comp = safePtr.getComponent();
+
+        if (comp == nullptr)
+            return;
+
+        comp->matchButton.setEnabled(true);
+        comp->matchButton.setButtonText("Match...");
+
+        if (! result.succeeded)
+        {
+            AlertWindow::showMessageBoxAsync(MessageBoxIconType::WarningIcon, "Match EQ", result.error);
+            return;
+        }
+
+        comp->audioProcessor.setChainSettings(result.settings);
+    });
+}
+
 void ColinasEQAudioProcessorEditor::resized()
 {
     auto bounds = getLocalBounds();
@@ -724,6 +1525,39 @@ void ColinasEQAudioProcessorEditor::resized()
     
     responseCurveComponent.setBounds(responseArea);
     
+    auto optionsArea = bounds.removeFromTop(24).reduced(4, 0);
+    filterDesignBox.setBounds(optionsArea.removeFromRight(110));
+    autoGainButton.setBounds(optionsArea.removeFromRight(100));
+    matchButton.setBounds(optionsArea.removeFromRight(80).reduced(0, 2));
+    waterfallButton.setBounds(optionsArea.removeFromLeft(100));
+    prePostButton.setBounds(optionsArea.removeFromLeft(100));
+    overlayButton.setBounds(optionsArea.removeFromLeft(100));
+    
+    auto meterArea = bounds.removeFromTop(28).reduced(4, 2);
+    inputMeterComponent.setBounds(meterArea.removeFromLeft(meterArea.getWidth() / 2).reduced(2, 0));
+    outputMeterComponent.setBounds(meterArea.reduced(2, 0));
+    
+    auto snapshotArea = bounds.removeFromBottom(30).reduced(4, 2);
+    storeAButton.setBounds(snapshotArea.removeFromLeft(70));
+    storeBButton.setBounds(snapshotArea.removeFromLeft(70));
+    morphEnabledButton.setBounds(snapshotArea.removeFromLeft(80));
+    slotToBButton.setBounds(snapshotArea.removeFromRight(50));
+    slotToAButton.setBounds(snapshotArea.removeFromRight(50));
+    saveSlotButton.setBounds(snapshotArea.removeFromRight(50));
+    snapshotSlotBox.setBounds(snapshotArea.removeFromRight(90));
+    morphSlider.setBounds(snapshotArea);
+    
+    auto dynamicsArea = bounds.removeFromBottom(100);
+    auto dynamicsButtonArea = dynamicsArea.removeFromLeft(100);
+    peakDynamicButton.setBounds(dynamicsButtonArea.removeFromTop(dynamicsButtonArea.getHeight() / 2));
+    peakSidechainButton.setBounds(dynamicsButtonArea);
+    
+    auto dynamicsSliderWidth = dynamicsArea.getWidth() / 4;
+    peakThresholdSlider.setBounds(dynamicsArea.removeFromLeft(dynamicsSliderWidth));
+    peakRatioSlider.setBounds(dynamicsArea.removeFromLeft(dynamicsSliderWidth));
+    peakAttackSlider.setBounds(dynamicsArea.removeFromLeft(dynamicsSliderWidth));
+    peakReleaseSlider.setBounds(dynamicsArea);
+    
     auto lowCutArea = bounds.removeFromLeft(bounds.getWidth() * 0.33);
     auto highCutArea = bounds.removeFromRight(bounds.getWidth() * 0.5);
     
@@ -761,7 +1595,32 @@ std::vector<juce::Component*> ColinasEQAudioProcessorEditor::getComps()
         &lowcutBypassButton,
         &peakBypassButton,
         &highcutBypassButton,
-        &analyzerEnabledButton
+        &analyzerEnabledButton,
+        
+        &storeAButton,
+        &storeBButton,
+        &morphEnabledButton,
+        &morphSlider,
+        &snapshotSlotBox,
+        &saveSlotButton,
+        &slotToAButton,
+        &slotToBButton,
+        
+        &peakThresholdSlider,
+        &peakRatioSlider,
+        &peakAttackSlider,
+        &peakReleaseSlider,
+        &peakDynamicButton,
+        &peakSidechainButton,
+        
+        &filterDesignBox,
+        &waterfallButton,
+        &prePostButton,
+        &overlayButton,
+        &autoGainButton,
+        &matchButton,
+        &inputMeterComponent,
+        &outputMeterComponent
     };
 }
 
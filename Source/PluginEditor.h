@@ -10,164 +10,181 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "AnalyzerDecimator.h"
+#include "FFTDataGenerator.h"
+#include "MatchEQ.h"
+#include "PaintProfiler.h"
+#include "SpectrumRegistry.h"
+#include "TraceRenderer.h"
+#include "Waterfall.h"
 
 
-enum FFTOrder
+struct AnalyzerTraceGenerator
 {
-    order2048 = 11,
-    order4096 = 12,
-    order8192 = 13
-};
+    // A finer spectrum of a decimated copy of the signal, used for every bin below crossover
+    struct LowBand
+    {
+        const float* data = nullptr;
+        float binWidth = 0.f;
+        float crossover = 0.f;
+    };
 
-template<typename BlockType>
-struct FFTDataGenerator
-{
-    /**
-     produces the FFT data from an audio buffer.
+    /*
+     converts 'renderData[]' into one y position per pixel column of fftBounds, for the TraceRenderer.
+     Columns covering several bins show the loudest one, columns between bins are interpolated.
      */
-    void produceFFTDataForRendering(const juce::AudioBuffer<float>& audioData, const float negativeInfinity)
+    void generateTrace(const float* renderData,
+                       juce::Rectangle<float> fftBounds,
+                       int fftSize,
+                       float binWidth,
+                       float negativeInfinity,
+                       const LowBand* lowBand = nullptr)
     {
-        const auto fftSize = getFFTSize();
-        
-        fftData.assign(fftData.size(), 0);
-        auto* readIndex = audioData.getReadPointer(0);
-        std::copy(readIndex, readIndex + fftSize, fftData.begin());
-        
-        // first apply a windowing function to our data
-        window->multiplyWithWindowingTable (fftData.data(), fftSize);       // [1]
-        
-        // then render our FFT data..
-        forwardFFT->performFrequencyOnlyForwardTransform (fftData.data());  // [2]
-        
-        int numBins = (int)fftSize / 2;
-        
-        //normalize the fft values.
-        for( int i = 0; i < numBins; ++i )
+        auto top = fftBounds.getY();
+        auto bottom = fftBounds.getHeight();
+
+        auto map = [bottom, top, negativeInfinity](float v)
         {
-            auto v = fftData[i];
-//            fftData[i] /= (float) numBins;
-            if( !std::isinf(v) && !std::isnan(v) )
-            {
-                v /= float(numBins);
-            }
-            else
-            {
-                v = 0.f;
-            }
-            fftData[i] = v;
-        }
-        
-        //convert them to decibels
-        for( int i = 0; i < numBins; ++i )
+            return juce::jmap(v,
+                              negativeInfinity, 0.f,
+                              float(bottom+10),   top);
+        };
+
+        generate(renderData, fftBounds, fftSize, binWidth, map, false, lowBand);
+    }
+
+    /*
+     converts a difference in dB per bin into y positions on the response curve's +/-24 dB scale.
+     Columns covering several bins show their average, so noise does not push the difference up.
+     */
+    void generateDifferenceTrace(const float* differenceData,
+                                 juce::Rectangle<float> fftBounds,
+                                 int fftSize,
+                                 float binWidth,
+                                 const LowBand* lowBand = nullptr)
+    {
+        auto height = fftBounds.getHeight();
+
+        auto map = [height](float v)
         {
-            fftData[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
-        }
-        
-        fftDataFifo.push(fftData);
+            return juce::jmap(v, -24.f, 24.f, height, 0.f);
+        };
+
+        generate(differenceData, fftBounds, fftSize, binWidth, map, true, lowBand);
     }
-    
-    void changeOrder(FFTOrder newOrder)
+
+    int getNumTracesAvailable() const
     {
-        //when you change order, recreate the window, forwardFFT, fifo, fftData
-        //also reset the fifoIndex
-        //things that need recreating should be created on the heap via std::make_unique<>
-        
-        order = newOrder;
-        auto fftSize = getFFTSize();
-        
-        forwardFFT = std::make_unique<juce::dsp::FFT>(order);
-        window = std::make_unique<juce::dsp::WindowingFunction<float>>(fftSize, juce::dsp::WindowingFunction<float>::blackmanHarris);
-        
-        fftData.clear();
-        fftData.resize(fftSize * 2, 0);
+        return traceFifo.getNumAvailableForReading();
+    }
 
-        fftDataFifo.prepare(fftData.size());
+    bool getTrace(std::vector<float>& t)
+    {
+        return traceFifo.pull(t);
     }
-    //==============================================================================
-    int getFFTSize() const { return 1 << order; }
-    int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
-    //==============================================================================
-    bool getFFTData(BlockType& fftData) { return fftDataFifo.pull(fftData); }
-private:
-    FFTOrder order;
-    BlockType fftData;
-    std::unique_ptr<juce::dsp::FFT> forwardFFT;
-    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
-    
-    Fifo<BlockType> fftDataFifo;
-};
 
-template<typename PathType>
-struct AnalyzerPathGenerator
-{
-    /*
-     converts 'renderData[]' into a juce::Path
-     */
-    void generatePath(const std::vector<float>& renderData,
-                      juce::Rectangle<float> fftBounds,
-                      int fftSize,
-                      float binWidth,
-                      float negativeInfinity)
+    size_t getNumBytes() const
     {
-        auto top = fftBounds.getY();
-        auto bottom = fftBounds.getHeight();
-        auto width = fftBounds.getWidth();
+        return trace.capacity() * sizeof(float) + binsInColumn.capacity() * sizeof(int) + traceFifo.getNumBytes();
+    }
+private:
+    template<typename LevelToY>
+    void generate(const float* renderData,
+                  juce::Rectangle<float> fftBounds,
+                  int fftSize,
+                  float binWidth,
+                  LevelToY&& map,
+                  bool averageColumns,
+                  const LowBand* lowBand)
+    {
+        auto width = juce::jmax(1, (int)fftBounds.getWidth());
 
         int numBins = (int)fftSize / 2;
 
-        PathType p;
-        p.preallocateSpace(3 * (int)fftBounds.getWidth());
+        if( (int)trace.size() != width )
+        {
+            trace.resize(width);
+            // traces are read as soon as they are produced
+            traceFifo.setCapacity(1);
+            traceFifo.prepare(trace.size());
+        }
 
-        auto map = [bottom, top, negativeInfinity](float v)
+        std::fill(trace.begin(), trace.end(), std::numeric_limits<float>::quiet_NaN());
+
+        if( averageColumns )
+            binsInColumn.assign(width, 0);
+
+        auto addBin = [&](float level, float binFreq)
         {
-            return juce::jmap(v,
-                              negativeInfinity, 0.f,
-                              float(bottom+10),   top);
+            auto y = map(level);
+
+            if( std::isnan(y) || std::isinf(y) )
+                return;
+
+            auto normalizedBinX = juce::mapFromLog10(binFreq, 20.f, 20000.f);
+            int binX = std::floor(normalizedBinX * width);
+
+            if( ! juce::isPositiveAndBelow(binX, width) )
+                return;
+
+            if( std::isnan(trace[binX]) )
+                trace[binX] = y;
+            else
+                trace[binX] = averageColumns ? trace[binX] + y : juce::jmin(trace[binX], y);
+
+            if( averageColumns )
+                ++binsInColumn[binX];
         };
 
-        auto y = map(renderData[0]);
+        int firstBin = 1;
 
-//        jassert( !std::isnan(y) && !std::isinf(y) );
-        if( std::isnan(y) || std::isinf(y) )
-            y = bottom;
-        
-        p.startNewSubPath(0, y);
+        if( lowBand != nullptr )
+        {
+            for( int binNum = 1; binNum < numBins && binNum * lowBand->binWidth < lowBand->crossover; ++binNum )
+                addBin(lowBand->data[binNum], binNum * lowBand->binWidth);
+
+            firstBin = juce::jmax(1, (int)std::ceil(lowBand->crossover / binWidth));
+        }
+
+        for( int binNum = firstBin; binNum < numBins; ++binNum )
+            addBin(renderData[binNum], binNum * binWidth);
 
-        const int pathResolution = 2; //you can draw line-to's every 'pathResolution' pixels.
+        if( averageColumns )
+            for( int x = 0; x < width; ++x )
+                if( binsInColumn[x] > 1 )
+                    trace[x] /= float(binsInColumn[x]);
 
-        for( int binNum = 1; binNum < numBins; binNum += pathResolution )
+        // low frequencies have fewer bins than columns, so join the gaps
+        int previous = -1;
+        for( int x = 0; x < width; ++x )
         {
-            y = map(renderData[binNum]);
+            if( std::isnan(trace[x]) )
+                continue;
 
-//            jassert( !std::isnan(y) && !std::isinf(y) );
+            if( previous < 0 )
+                std::fill(trace.begin(), trace.begin() + x, trace[x]);
+            else
+                for( int gap = previous + 1; gap < x; ++gap )
+                    trace[gap] = juce::jmap(float(gap), float(previous), float(x), trace[previous], trace[x]);
 
-            if( !std::isnan(y) && !std::isinf(y) )
-            {
-                auto binFreq = binNum * binWidth;
-                auto normalizedBinX = juce::mapFromLog10(binFreq, 20.f, 20000.f);
-                int binX = std::floor(normalizedBinX * width);
-                p.lineTo(binX, y);
-            }
+            previous = x;
         }
 
-        pathFifo.push(p);
-    }
+        if( previous >= 0 )
+            std::fill(trace.begin() + previous + 1, trace.end(), trace[previous]);
 
-    int getNumPathsAvailable() const
-    {
-        return pathFifo.getNumAvailableForReading();
+        traceFifo.push(trace);
     }
 
-    bool getPath(PathType& path)
-    {
-        return pathFifo.pull(path);
-    }
-private:
-    Fifo<PathType> pathFifo;
+    std::vector<float> trace;
+    std::vector<int> binsInColumn;
+    Fifo<std::vector<float>> traceFifo;
 };
 
 
 
+struct RotarySliderWithLabels;
+
 struct LookAndFeel : juce::LookAndFeel_V4
 {
     void drawRotarySlider (juce::Graphics&,
@@ -177,6 +194,17 @@ struct LookAndFeel : juce::LookAndFeel_V4
                            float rotaryEndAngle,
                            juce::Slider&) override;
     
+    // The parts of drawRotarySlider that do not depend on the value, and the ones that do
+    void drawRotarySliderBody (juce::Graphics&, juce::Rectangle<float> bounds, bool enabled);
+    void drawRotarySliderPointer (juce::Graphics&,
+                                  juce::Rectangle<float> bounds,
+                                  float sliderPosProportional,
+                                  float rotaryStartAngle,
+                                  float rotaryEndAngle,
+                                  const RotarySliderWithLabels&,
+                                  const juce::String& valueText,
+                                  int valueTextWidth);
+    
     void drawToggleButton (juce::Graphics &g,
                            juce::ToggleButton & toggleButton,
                            bool shouldDrawButtonAsHighlighted,
@@ -213,41 +241,116 @@ struct RotarySliderWithLabels : juce::Slider
     juce::Rectangle<int> getSliderBounds() const;
     int getTextHeight () const { return 14; }
     juce::String getDisplayString() const;
+    /** Writes the value text into 'buffer' without allocating. Returns the number of characters written */
+    int formatDisplayString(char* buffer, size_t bufferSize) const;
     
     private:
     LookAndFeel lnf;
     juce::RangedAudioParameter* param;
     juce::String suffix;
     
+    void updateStaticLayer(juce::Graphics& g, float startAngle, float endAngle);
     
+    // Body, outline and range labels at physical resolution, redrawn when the size, scale or enablement change
+    juce::Image staticLayer;
+    float staticLayerScale = 0.f;
+    bool staticLayerEnabled = false;
+    int staticLayerNumLabels = -1;
+    
+    // The value text is only turned into a String when it changes
+    std::array<char, 32> valueText {};
+    juce::String valueString;
+    int valueStringWidth = 0;
+    
+#if COLINASEQ_ENABLE_PAINT_PROFILING
+    juce::SharedResourcePointer<PaintProfiler> paintProfiler;
+#endif
 };
 
 struct PathProducer
 
 {
-    PathProducer (SingleChannelSampleFifo<ColinasEQAudioProcessor::BlockType>& scsf) :
-    leftChannelFifo(&scsf)
+    PathProducer (ColinasEQAudioProcessor::AnalyzerFifos& fifos) :
+    leftChannelFifo(&fifos.leftChannelFifo),
+    rightChannelFifo(&fifos.rightChannelFifo),
+    preEqFifo(&fifos.preEqFifo),
+    postEqFifo(&fifos.postEqFifo)
     {
-        leftChannelFFTDataGenerator.changeOrder(FFTOrder::order2048);
-        monoBuffer.setSize(1, leftChannelFFTDataGenerator.getFFTSize());
+        fftDataGenerator.changeOrder(FFTOrder::order2048);
+        stereoBuffer.setSize(2, fftDataGenerator.getFFTSize());
+        
+        lowBandGenerator.changeOrder(FFTOrder::order2048);
+        lowBandBuffer.setSize(2, lowBandGenerator.getFFTSize());
     }
     
     
-    void process(juce::Rectangle<float> fftBounds, double sampleRate);
-    juce::Path getPath() { return leftChannelFFTPath;
-        
-}
+    /**
+     Returns true if new analyzer traces were produced that look different from the last ones,
+     or the waterfall still has something moving. A stopped host gives frames that don't
+     */
+    bool process(juce::Rectangle<float> fftBounds, double sampleRate);
+    const std::vector<float>& getLeftTrace() const { return leftChannelTrace; }
+    const std::vector<float>& getRightTrace() const { return rightChannelTrace; }
+    int getFFTSize() const { return fftDataGenerator.getFFTSize(); }
+    
+    /**
+     In pre/post mode the left and right traces show the mid signal before and after the EQ,
+     still packed into one FFT, and the difference trace shows what the EQ did to it.
+     The processor's taps have to be switched over to match.
+     */
+    void setPrePostMode(bool enabled);
+    bool isPrePostMode() const { return prePostMode; }
+    const std::vector<float>& getDifferenceTrace() const { return differenceTrace; }
+    
+    /** Every FFT frame is also written into the waterfall while one is set */
+    void setWaterfall(Waterfall* newWaterfall) { waterfall = newWaterfall; }
+    
+    size_t getNumBytes() const;
     
     private:
     SingleChannelSampleFifo<ColinasEQAudioProcessor::BlockType>* leftChannelFifo;
+    SingleChannelSampleFifo<ColinasEQAudioProcessor::BlockType>* rightChannelFifo;
+    SingleChannelSampleFifo<ColinasEQAudioProcessor::BlockType>* preEqFifo;
+    SingleChannelSampleFifo<ColinasEQAudioProcessor::BlockType>* postEqFifo;
     
-    juce::AudioBuffer<float>monoBuffer;
+    bool prePostMode = false;
     
-    FFTDataGenerator<std::vector<float>> leftChannelFFTDataGenerator;
+    juce::AudioBuffer<float> stereoBuffer;
     
-    AnalyzerPathGenerator<juce::Path> pathProducer;
+    FFTDataGenerator<std::vector<float>> fftDataGenerator;
+    std::vector<float> fftData;
     
-    juce::Path leftChannelFFTPath;
+    /** Returns true if the waterfall visibly changed */
+    bool transformFrame(int numBins);
+    void transformLowBand(int numBins);
+    /** Returns how far the traces moved since the last frame, in pixels */
+    float generateTraces(juce::Rectangle<float> fftBounds, int fftSize, float binWidth);
+    
+    // Traces that move less than this don't count as a new frame
+    static constexpr float MinTraceChangePixels = 0.5f;
+    std::vector<float> previousTrace;
+    
+    /**
+     The low band: the same FFT size on the signal decimated by AnalyzerDecimator::Factor,
+     giving Factor times finer bins below the crossover. Its window spans Factor times longer,
+     so it only needs transforming once every Factor buffers, and the latest result is
+     combined with every full rate frame. Together they cost barely more than one FFT.
+     */
+    AnalyzerDecimator decimator;
+    juce::AudioBuffer<float> lowBandBuffer;
+    FFTDataGenerator<std::vector<float>> lowBandGenerator;
+    std::vector<float> lowBandData, lowBandDifferenceData;
+    int buffersSinceLowBand = 0;
+    double preparedSampleRate = 0.0;
+    
+    AnalyzerTraceGenerator leftTraceGenerator, rightTraceGenerator, differenceTraceGenerator;
+    
+    std::vector<float> leftChannelTrace, rightChannelTrace, differenceTrace;
+    
+    // Post minus pre in dB per bin
+    std::vector<float> differenceData;
+    
+    Waterfall* waterfall = nullptr;
 };
 
 
@@ -268,29 +371,121 @@ juce::Timer
     void paint(juce::Graphics& g) override;
     
     void resized() override;
+    
+    /** Shows a scrolling spectrogram in place of the analyzer traces, under the response curve */
+    void setWaterfallEnabled(bool enabled);
+    /** Shows the spectrum before and after the EQ, and their difference, in place of left and right */
+    void setPrePostEnabled(bool enabled);
+    
+    /** Adds the analyzer pipeline and the cached layers to a footprint */
+    void addMemoryFootprint(MemoryFootprint& footprint) const;
+    
+    /** Overlays the spectra other instances publish, and highlights where they overlap this one */
+    void setOverlayEnabled(bool enabled);
 private:
     
+    /** Polls the analyzer and the parameters, and repaints only if something changed.
+        Runs once per display frame, or from the timer where there is no vblank callback */
+    void onFrame();
+    
+    // After this many frames without changes, polling drops to the idle rate
+    static constexpr int IdleFramesBeforeSlowdown = 30;
+    static constexpr int ActiveRateHz = 60, IdleRateHz = 10;
+    static_assert(IdleRateHz >= AnalyzerMinReadRateHz, "the capture FIFOs are sized for reads at AnalyzerMinReadRateHz");
+    int idleFrames = 0;
+    
+    // Displays run at 60 Hz and up, so the number of vblanks to skip while idle comes from their measured interval
+    double lastVBlankMs = 0.0;
+    double vBlankIntervalMs = 1000.0 / ActiveRateHz;
+    
     ColinasEQAudioProcessor& audioProcessor;
     
     juce::Atomic<bool> parametersChanged { false } ;
     
+    int snapshotBankVersion = -1;
+    
     MonoChain monoChain;
     
+    juce::SharedResourcePointer<CoefficientCache> coefficientCache;
+    
     void updateChain();
     
+    // The grid and its labels at physical pixel resolution, rebuilt when the size or the display scale change
     juce::Image background;
+    float backgroundScale = 1.f;
+    void updateBackground(float scale);
+    
+    // Analyzer traces and the response curve are rasterised into their own layers at the same scale.
+    // The analyzer layer is redrawn on new frames, the response layer when the chain changes
+    juce::Image analyzerLayer, responseLayer;
+    TraceRenderer analyzerRenderer, responseRenderer;
+    bool analyzerLayerDirty = true, responseLayerDirty = true;
+    void updateAnalyzerLayer(float scale);
+    void updateResponseLayer(float scale);
+    
+    Waterfall waterfall;
+    bool waterfallEnabled = false;
+    
+#if COLINASEQ_ENABLE_PAINT_PROFILING
+    juce::SharedResourcePointer<PaintProfiler> paintProfiler;
+#endif
+    
+    // Spectrum sharing between instances. Every processor publishes while someone subscribes, this editor only reads
+    juce::SharedResourcePointer<SpectrumRegistry> spectrumRegistry;
+    bool overlayEnabled = false;
+    SpectrumRegistry::Levels ownLevels, otherLevels;
+    
+    // Both tracks above this level in a band counts as masking
+    static constexpr float MaskingThresholdDecibels = -36.f;
+    std::array<bool, SpectrumRegistry::NumBands> maskedBands {};
+    std::vector<std::vector<float>> otherTraces;
+    size_t numOtherTraces = 0;
+    
+    /** Reads this instance's and the other instances' spectra. Returns true if there is anything to draw or to clear */
+    bool updateOverlay(juce::Rectangle<float> fftBounds);
     
     juce::Rectangle<int> getRenderArea();
     
     juce::Rectangle<int> getAnalysisArea();
     
-    PathProducer leftPathProducer, rightPathProducer;
+    // Acquired from the processor for as long as this component exists
+    ColinasEQAudioProcessor::AnalyzerFifos& analyzerFifos;
+    
+    PathProducer pathProducer;
     
+#if JUCE_MAJOR_VERSION >= 7
+    // Declared last so it only starts calling back once everything else exists
+    juce::VBlankAttachment vBlankAttachment;
+    int skippedFrames = 0;
+#endif
 };
 
 //==============================================================================
 
 
+/** Horizontal peak and RMS bars for one meter point, with the true peak hold and short-term loudness as text */
+struct LevelMeterComponent : juce::Component, juce::Timer
+{
+    LevelMeterComponent(LevelMeter& meterToShow, const juce::String& labelText);
+    
+    void paint(juce::Graphics& g) override;
+    void timerCallback() override;
+    /** Clicking clears the true peak hold */
+    void mouseDown(const juce::MouseEvent&) override;
+    
+private:
+    static constexpr float MinDecibels = -60.f, MaxDecibels = 6.f;
+    // About 20 dB per second at the refresh rate
+    static constexpr int RefreshRateHz = 30;
+    static constexpr float PeakDecayDecibels = 20.f / RefreshRateHz;
+    
+    LevelMeter& meter;
+    juce::String label;
+    LevelMeter::Reading reading;
+    std::array<float, LevelMeter::MaxChannels> peakDecibels { -100.f, -100.f };
+    float truePeakHoldDecibels = -100.f;
+};
+
 struct PowerButton : juce::ToggleButton { };
 
 class ColinasEQAudioProcessorEditor  : public juce::AudioProcessorEditor
@@ -302,6 +497,21 @@ public:
     void paint (juce::Graphics&) override;
     void resized() override;
     
+    /** Everything this instance holds, with the editor open */
+    MemoryFootprint getMemoryFootprint();
+    
+#if COLINASEQ_ENABLE_PAINT_PROFILING
+    /**
+     Renders the editor into offscreen images with the software renderer, at every size and scale,
+     framesPerConfiguration times each. Before each frame, noise is run through the processor and
+     the response curve's frame callback is driven by hand, so no window, peer or display is needed.
+     Prepares the processor itself. Returns the frame time percentiles of each configuration
+     */
+    juce::String runPaintBenchmark(const std::vector<juce::Point<int>>& sizes,
+                                   const std::vector<float>& scales,
+                                   int framesPerConfiguration);
+#endif
+    
 private:
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
@@ -351,6 +561,55 @@ private:
                     highcutBypassButtonAttachment,
                     analyzerEnabledButtonAttachment;
     
+    // Snapshot bank and morph controls
+    juce::TextButton storeAButton { "Store A" }, storeBButton { "Store B" };
+    juce::ToggleButton morphEnabledButton { "Morph" };
+    juce::Slider morphSlider { juce::Slider::SliderStyle::LinearHorizontal, juce::Slider::TextEntryBoxPosition::NoTextBox };
+    juce::ComboBox snapshotSlotBox;
+    juce::TextButton saveSlotButton { "Save" }, slotToAButton { "To A" }, slotToBButton { "To B" };
+    
+    Attachment morphSliderAttachment;
+    ButtonAttachment morphEnabledButtonAttachment;
+    
+    // Dynamic peak band controls
+    RotarySliderWithLabels peakThresholdSlider,
+    peakRatioSlider,
+    peakAttackSlider,
+    peakReleaseSlider;
+    
+    juce::ToggleButton peakDynamicButton { "Dynamic" }, peakSidechainButton { "Sidechain" };
+    
+    Attachment peakThresholdSliderAttachment,
+                peakRatioSliderAttachment,
+                peakAttackSliderAttachment,
+                peakReleaseSliderAttachment;
+    
+    ButtonAttachment peakDynamicButtonAttachment,
+                    peakSidechainButtonAttachment;
+    
+    // Filter design choice. The attachment is created once the box has its items
+    juce::ComboBox filterDesignBox;
+    juce::ToggleButton waterfallButton { "Waterfall" };
+    juce::ToggleButton prePostButton { "Pre/Post" };
+    juce::ToggleButton overlayButton { "Overlay" };
+    std::unique_ptr<APVTS::ComboBoxAttachment> filterDesignBoxAttachment;
+    
+    juce::ToggleButton autoGainButton { "Auto Gain" };
+    ButtonAttachment autoGainButtonAttachment;
+    
+    // Match EQ. Asks for a reference, then for the track to EQ. The analysis threads are only created on first use
+    juce::TextButton matchButton { "Match..." };
+    std::unique_ptr<juce::FileChooser> referenceChooser, targetChooser;
+    std::unique_ptr<MatchEQ> matchEQ;
+    void chooseMatchFiles();
+    void startMatch(const juce::File& reference, const juce::File& target);
+    
+    LevelMeterComponent inputMeterComponent, outputMeterComponent;
+    
+#if COLINASEQ_ENABLE_PAINT_PROFILING
+    juce::SharedResourcePointer<PaintProfiler> paintProfiler;
+#endif
+    
     std::vector<juce::Component*> getComps();
     
     LookAndFeel lnf;
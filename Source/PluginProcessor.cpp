@@ -1,5 +1,6 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "SpectrumPublisher.h"
 
 //==============================================================================
 ColinasEQAudioProcessor::ColinasEQAudioProcessor()
@@ -8,16 +9,34 @@ ColinasEQAudioProcessor::ColinasEQAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
                        )
 #endif
 {
+    parameterBindings.bind(apvts);
+    
+    /** readBinaryState finds stored values by the hash of the parameter ID */
+    for (auto* param : getParameters())
+    {
+        auto* rap = dynamic_cast<juce::RangedAudioParameter*>(param);
+        jassert(rap != nullptr);
+        
+        parameterIndexByIdHash[rap->paramID.hashCode()] = param->getParameterIndex();
+    }
+    
+    makeSecondOrderSections(leftChain);
+    makeSecondOrderSections(rightChain);
+    
+    /** Publishes for other instances' overlays whether or not this one's editor is open */
+    spectrumPublisher = std::make_unique<SpectrumPublisher>(*this);
 }
 
 ColinasEQAudioProcessor::~ColinasEQAudioProcessor()
 {
+    channelWorkers.stop();
 }
 
 //==============================================================================
@@ -98,22 +117,79 @@ void ColinasEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBl
     leftChain.prepare(spec);
     rightChain.prepare(spec);
     
+    leftChainState.reset();
+    rightChainState.reset();
+    
+    markFiltersStale();
     updateFilters();
     
-    leftChannelFifo.prepare(samplesPerBlock);
-    rightChannelFifo.prepare(samplesPerBlock);
+    peakDynamics.prepare(sampleRate, samplesPerBlock);
+    
+    autoGain.prepare(sampleRate);
+    autoGainNeedsUpdate = true;
+    
+    inputMeter.prepare(sampleRate);
+    outputMeter.prepare(sampleRate);
+    
+    morphAmount.reset(sampleRate, 0.05);
+    morphAmount.setCurrentAndTargetValue(parameterBindings.get(Params::Morph));
+    morphEngagement.reset(sampleRate, 0.05);
+    morphEngagement.setCurrentAndTargetValue(isMorphActive() ? 1.f : 0.f);
+    morphNeedsFullUpdate = true;
+    
+    slopeCrossfade.length = juce::jmax(1, juce::roundToInt(sampleRate * SlopeCrossfadeSeconds));
+    slopeCrossfade.remaining = 0;
+    chainsHaveRun = false;
+    
+    analyzerTapBuffer.setSize(2, samplesPerBlock, false, false, true);
+    
+    /** The analyzer FIFOs are only prepared here if an editor already created them */
+    {
+        const juce::SpinLock::ScopedLockType lock(analyzerLock);
+        maxBlockSize = samplesPerBlock;
+        
+        if (analyzerFifos != nullptr)
+            analyzerFifos->prepare(samplesPerBlock, sampleRate, preEqTapEnabled.load());
+        
+        if (spectrumFifos != nullptr)
+            spectrumFifos->prepare(samplesPerBlock, sampleRate, false);
+    }
     
-    osc.initialise([](float x) { return std::sin(x); });
+    /** Most hosts switch to non-realtime before preparing an offline render. Those that don't re-prepare go through setNonRealtime */
+    updateChannelWorkers(isNonRealtime());
     
+#if COLINASEQ_ENABLE_TEST_SIGNAL
     spec.numChannels = getTotalNumOutputChannels();
-    osc.prepare(spec);
-    osc.setFrequency(5000);
-
+    testSignal.prepare(spec);
+#endif
 }
 
 void ColinasEQAudioProcessor::releaseResources()
 {
+    channelWorkers.stop();
+}
 
+void ColinasEQAudioProcessor::setNonRealtime(bool isNonRealtime) noexcept
+{
+    /** Some wrappers pass the host's process level on every block, so only act on a change */
+    const bool changed = isNonRealtime != AudioProcessor::isNonRealtime();
+    AudioProcessor::setNonRealtime(isNonRealtime);
+    
+    if (! changed)
+        return;
+    
+    /** Hosts call this off the audio thread, but processBlock may still be running, so wait for it */
+    const juce::ScopedLock lock(getCallbackLock());
+    updateChannelWorkers(isNonRealtime);
+}
+
+void ColinasEQAudioProcessor::updateChannelWorkers(bool isNonRealtime)
+{
+    /** The caller runs one channel itself */
+    if (isNonRealtime)
+        channelWorkers.start(juce::jmin(getMainBusNumOutputChannels(), juce::SystemStats::getNumCpus()) - 1);
+    else
+        channelWorkers.stop();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -129,6 +205,13 @@ bool ColinasEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
+    
+    /** The dynamic peak band can listen to a mono or stereo sidechain */
+    auto sidechain = layouts.getChannelSet(true, 1);
+    if (! sidechain.isDisabled()
+     && sidechain != juce::AudioChannelSet::mono()
+     && sidechain != juce::AudioChannelSet::stereo())
+        return false;
    #endif
 
     return true;
@@ -136,6 +219,25 @@ bool ColinasEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
 }
 #endif
 
+namespace
+{
+    /** (L + R) / 2 of the first two channels, or the only channel of a mono bus */
+    void writeMidSignal(const juce::AudioBuffer<float>& source, float* destination)
+    {
+        auto numSamples = source.getNumSamples();
+        
+        if (source.getNumChannels() > 1)
+        {
+            juce::FloatVectorOperations::add(destination, source.getReadPointer(0), source.getReadPointer(1), numSamples);
+            juce::FloatVectorOperations::multiply(destination, 0.5f, numSamples);
+        }
+        else
+        {
+            juce::FloatVectorOperations::copy(destination, source.getReadPointer(0), numSamples);
+        }
+    }
+}
+
 void ColinasEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
@@ -145,35 +247,500 @@ void ColinasEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, ju
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    updateFilters();
+    /** The sidechain input follows the main bus in the buffer, so only process the main bus */
+    auto mainBuffer = getBusBuffer(buffer, false, 0);
+    juce::dsp::AudioBlock<float> block(mainBuffer);
+    
+#if COLINASEQ_ENABLE_TEST_SIGNAL
+    testSignal.process(block);
+#endif
+    
+    /** The input side of the pre-EQ taps has to be taken before the chains run */
+    const auto numSamples = mainBuffer.getNumSamples();
+    const bool tapPreEq = preEqTapEnabled.load(std::memory_order_relaxed)
+                          && numSamples <= analyzerTapBuffer.getNumSamples();
+    
+    if (tapPreEq)
+        writeMidSignal(mainBuffer, analyzerTapBuffer.getWritePointer(0));
+    
+    /** Metering is timed, the input and output passes together */
+    const bool metering = numMeterUsers.load(std::memory_order_relaxed) > 0;
+    const auto numMeterChannels = juce::jmin(LevelMeter::MaxChannels, mainBuffer.getNumChannels());
+    juce::int64 meteringTicks = 0;
+    
+    if (metering)
+    {
+        auto start = juce::Time::getHighResolutionTicks();
+        
+        if (! meteringWasActive)
+        {
+            inputMeter.reset();
+            outputMeter.reset();
+        }
+        
+        inputMeter.process(mainBuffer.getArrayOfReadPointers(), numMeterChannels, numSamples);
+        meteringTicks += juce::Time::getHighResolutionTicks() - start;
+    }
+    
+    meteringWasActive = metering;
+    
+    auto dynamicsSettings = parameterBindings.getPeakDynamicsSettings();
+    
+    /** Morphing carries on while it blends back to the live settings after being switched off */
+    morphEngagement.setTargetValue(isMorphActive() ? 1.f : 0.f);
+    auto morphing = morphEngagement.getTargetValue() > 0.f || morphEngagement.isSmoothing();
+    
+    /** Once disengaged the amount follows the parameter directly, so switching morph on starts where the knob is */
+    if (! morphing)
+        morphAmount.setCurrentAndTargetValue(parameterBindings.get(Params::Morph));
+    
+    /** The peak coefficients need restoring after the dynamic band is switched off */
+    if (peakDynamicsWasEnabled && ! dynamicsSettings.enabled)
+    {
+        morphNeedsFullUpdate = true;
+        peakStale = true;
+    }
+    
+    peakDynamicsWasEnabled = dynamicsSettings.enabled;
+    
+    if (morphing || dynamicsSettings.enabled || slopeCrossfade.remaining > 0)
+    {
+        /** The dynamic band listens to the external sidechain if it is connected, otherwise to the input */
+        auto sidechainBuffer = getBusCount(true) > 1 ? getBusBuffer(buffer, true, 1) : juce::AudioBuffer<float>();
+        const auto& detectionBuffer = dynamicsSettings.useSidechain && sidechainBuffer.getNumChannels() > 0 ? sidechainBuffer
+                                                                                                              : mainBuffer;
+        
+        processInSubBlocks(block, detectionBuffer, morphing, dynamicsSettings);
+    }
+    else
+    {
+        morphNeedsFullUpdate = true;
+        
+        updateFilters();
+        processChains(block, shouldProcessInParallel(numSamples));
+    }
     
-    juce::dsp::AudioBlock<float> block(buffer);
+    recoverNonFiniteStates(block);
     
-//    testing the spectrum analyzer with sound waves
-//    buffer.clear();
-//    
-//    juce::dsp::ProcessContextReplacing<float> stereoContext(block);
-//    osc.process(stereoContext);
+    /** The compensation is only worked out again when the settings changed, at most once per block, and not at all while it is off */
+    const bool autoGainEnabled = parameterBindings.getBool(Params::AutoGain);
     
+    if (autoGainEnabled)
+        updateAutoGain(morphing ? lastMorphedSettings : appliedSettings, dynamicsSettings.enabled);
     
+    autoGain.setEnabled(autoGainEnabled);
+    autoGain.process(block);
     
+    if (metering && numSamples > 0)
+    {
+        auto start = juce::Time::getHighResolutionTicks();
+        outputMeter.process(mainBuffer.getArrayOfReadPointers(), numMeterChannels, numSamples);
+        meteringTicks += juce::Time::getHighResolutionTicks() - start;
+        
+        auto nanosecondsPerSample = (float) (juce::Time::highResolutionTicksToSeconds(meteringTicks) * 1.0e9 / numSamples);
+        meteringCost.store(meteringCost.load(std::memory_order_relaxed) * 0.9f + nanosecondsPerSample * 0.1f, std::memory_order_relaxed);
+    }
     
-    /** An AudioBlock is required when creating a ProcessContextReplacing.
-        @see ProcessContextReplacing */
+    /** Only feed the analyzer while an editor is open */
+    const juce::SpinLock::ScopedTryLockType analyzerTryLock(analyzerLock);
+    if (analyzerTryLock.isLocked() && analyzerFifos != nullptr && analyzerFifos->leftChannelFifo.isPrepared())
+    {
+        if (tapPreEq)
+        {
+            /** The taps can be switched off, and the pair freed, after this block started */
+            if (analyzerFifos->preEqFifo.isPrepared())
+            {
+                writeMidSignal(mainBuffer, analyzerTapBuffer.getWritePointer(1));
+                
+                /** Refers to the tap buffer's memory, trimmed to this block. Both taps are pushed together so they stay paired */
+                BlockType taps(analyzerTapBuffer.getArrayOfWritePointers(), 2, numSamples);
+                analyzerFifos->preEqFifo.update(taps);
+                analyzerFifos->postEqFifo.update(taps);
+            }
+        }
+        
+        if (! tapPreEq || leftRightCaptureWanted.load(std::memory_order_relaxed))
+        {
+            analyzerFifos->leftChannelFifo.update(buffer);
+            analyzerFifos->rightChannelFifo.update(buffer);
+        }
+    }
     
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
+    /** And the spectrum publisher's capture while some editor shows the overlay */
+    if (analyzerTryLock.isLocked() && spectrumFifos != nullptr && spectrumFifos->leftChannelFifo.isPrepared())
+    {
+        spectrumFifos->leftChannelFifo.update(buffer);
+        spectrumFifos->rightChannelFifo.update(buffer);
+    }
+}
+
+void ColinasEQAudioProcessor::processChains(juce::dsp::AudioBlock<float>& block, bool inParallel)
+{
+    jassert(chainKernel != nullptr);
     
-    /** The process chain requires a ProcessContextReplacing to be passed to it in order to run the links in the chain */
-    juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
+    /** Both chains always carry the same coefficients, so the left chain's serve both channels */
+    auto sectionCoefficients = getSectionCoefficients(leftChain);
+    auto numSamples = (int) block.getNumSamples();
+    chainsHaveRun = true;
     
-    /** Passes the context to the mono filter chains*/
-    leftChain.process(leftContext);
-    rightChain.process(rightContext);
+    if (inParallel)
+    {
+        const ChannelTask tasks[]
+        {
+            { chainKernel, &sectionCoefficients, &leftChainState, block.getChannelPointer(0), numSamples },
+            { chainKernel, &sectionCoefficients, &rightChainState, block.getChannelPointer(1), numSamples }
+        };
+        
+        channelWorkers.run(tasks, (int) std::size(tasks));
+        return;
+    }
     
-    leftChannelFifo.update(buffer);
-    rightChannelFifo.update(buffer);
+    chainKernel(sectionCoefficients, leftChainState, block.getChannelPointer(0), numSamples);
+    chainKernel(sectionCoefficients, rightChainState, block.getChannelPointer(1), numSamples);
+}
+
+void ColinasEQAudioProcessor::recoverNonFiniteStates(juce::dsp::AudioBlock<float>& block)
+{
+    const std::array<ChainKernels::State*, 2> states { &leftChainState, &rightChainState };
+    
+    for (size_t channel = 0; channel < states.size(); ++channel)
+    {
+        if (states[channel]->resetNonFiniteSections() > 0)
+        {
+            /** This block came out of the broken state, so send silence rather than garbage */
+            block.getSingleChannelBlock(channel).clear();
+            filterResetCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    
+    /** A NaN that reached the detector would otherwise hold the dynamic gain at the static one for good */
+    if (peakDynamics.resetIfNonFinite())
+        filterResetCount.fetch_add(1, std::memory_order_relaxed);
+    
+    /** The frozen chain of a running crossfade is mixed into both channels, so a broken one drops the fade and the block */
+    if (slopeCrossfade.remaining > 0
+        && slopeCrossfade.leftState.resetNonFiniteSections() + slopeCrossfade.rightState.resetNonFiniteSections() > 0)
+    {
+        slopeCrossfade.remaining = 0;
+        block.clear();
+        filterResetCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool ColinasEQAudioProcessor::shouldProcessInParallel(int numSamples) const
+{
+    /** Realtime processing never touches the workers */
+    return isNonRealtime()
+        && channelWorkers.isRunning()
+        && numSamples >= MinParallelBlockSize
+        && parameterBindings.getBool(Params::ParallelRender);
+}
+
+void ColinasEQAudioProcessor::selectChainKernel(const ChainSettings& chainSettings)
+{
+    chainKernel = ChainKernels::getKernel(chainSettings.lowCutSlope,
+                                          chainSettings.highCutSlope,
+                                          chainSettings.lowCutBypassed,
+                                          chainSettings.peakBypassed,
+                                          chainSettings.highCutBypassed);
+}
+
+namespace
+{
+    using Biquad = std::array<float, 5>;
+    
+    /** The peak band's section, designed by value */
+    Biquad makePeakSection(const ChainSettings& chainSettings, double sampleRate)
+    {
+        const auto frequency = (double) clampDesignFrequency(chainSettings.peakFreq, sampleRate);
+        const auto gain = juce::Decibels::decibelsToGain((double) chainSettings.peakGainDecibels);
+        
+        if (chainSettings.designMode == Design_Matched)
+            return MatchedDesign::makePeak(sampleRate, frequency, chainSettings.peakQuality, gain);
+        
+        return BilinearDesign::makePeak(sampleRate, frequency, chainSettings.peakQuality, gain);
+    }
+    
+    /** Whether a band's design differs between two settings */
+    bool lowCutChanged(const ChainSettings& a, const ChainSettings& b)
+    {
+        return a.designMode != b.designMode
+            || a.lowCutFreq != b.lowCutFreq
+            || a.lowCutSlope != b.lowCutSlope
+            || a.lowCutBypassed != b.lowCutBypassed;
+    }
+    
+    bool peakChanged(const ChainSettings& a, const ChainSettings& b)
+    {
+        return a.designMode != b.designMode
+            || a.peakFreq != b.peakFreq
+            || a.peakGainDecibels != b.peakGainDecibels
+            || a.peakQuality != b.peakQuality
+            || a.peakBypassed != b.peakBypassed;
+    }
+    
+    bool highCutChanged(const ChainSettings& a, const ChainSettings& b)
+    {
+        return a.designMode != b.designMode
+            || a.highCutFreq != b.highCutFreq
+            || a.highCutSlope != b.highCutSlope
+            || a.highCutBypassed != b.highCutBypassed;
+    }
+}
+
+bool ColinasEQAudioProcessor::isMorphActive()
+{
+    /** Only copy the snapshots again when the bank changed */
+    auto bankVersion = snapshotBank.getVersion();
+    if (bankVersion != morphBankVersion)
+    {
+        if (snapshotBank.tryCopyMorphPair(morphA, morphB, morphPairStored))
+        {
+            morphBankVersion = bankVersion;
+            morphNeedsFullUpdate = true;
+        }
+    }
+    
+    return morphPairStored && parameterBindings.getBool(Params::MorphEnabled);
+}
+
+void ColinasEQAudioProcessor::processInSubBlocks(juce::dsp::AudioBlock<float>& block,
+                                                 const juce::AudioBuffer<float>& detectionBuffer,
+                                                 bool morphing,
+                                                 const PeakDynamicsSettings& dynamicsSettings)
+{
+    auto chainSettings = parameterBindings.getChainSettings();
+    const auto liveSettings = chainSettings;
+    const auto designMode = chainSettings.designMode;
+    
+    if (morphing)
+    {
+        morphAmount.setTargetValue(parameterBindings.get(Params::Morph));
+        morphA.designMode = designMode;
+        morphB.designMode = designMode;
+    }
+    else
+    {
+        morphNeedsFullUpdate = true;
+        updateFilters(chainSettings);
+    }
+    
+    const auto numSamples = (int) block.getNumSamples();
+    
+    /** Coefficients follow the smoothed morph amount and the dynamic peak gain every SubBlockSize samples */
+    for (int start = 0; start < numSamples; start += SubBlockSize)
+    {
+        auto length = juce::jmin(SubBlockSize, numSamples - start);
+        
+        if (morphing)
+        {
+            auto amount = morphAmount.skip(length);
+            auto engagement = morphEngagement.skip(length);
+            
+            if (morphNeedsFullUpdate || amount != lastMorphAmount || engagement != lastMorphEngagement
+                || designMode != lastMorphedSettings.designMode)
+            {
+                /** Fully engaged this is the morph itself. While switching on or off it blends with the live settings */
+                applyMorphedSettings(interpolateChainSettings(liveSettings, interpolateChainSettings(morphA, morphB, amount), engagement));
+                lastMorphAmount = amount;
+                lastMorphEngagement = engagement;
+            }
+            
+            chainSettings = lastMorphedSettings;
+        }
+        
+        if (dynamicsSettings.enabled && ! chainSettings.peakBypassed)
+        {
+            std::array<const float*, 2> detectionChannels {};
+            auto numDetectionChannels = juce::jmin(2, detectionBuffer.getNumChannels());
+            
+            for (int ch = 0; ch < numDetectionChannels; ++ch)
+                detectionChannels[(size_t) ch] = detectionBuffer.getReadPointer(ch, start);
+            
+            peakDynamics.setBand(clampDesignFrequency(chainSettings.peakFreq, getSampleRate()), chainSettings.peakQuality, designMode == Design_Matched);
+            auto gainDecibels = peakDynamics.process(detectionChannels.data(), numDetectionChannels, length,
+                                                     chainSettings.peakGainDecibels, dynamicsSettings);
+            
+            peakDynamics.applyGain(*leftChain.get<ChainPositions::Peak>().coefficients, gainDecibels);
+            peakDynamics.applyGain(*rightChain.get<ChainPositions::Peak>().coefficients, gainDecibels);
+        }
+        
+        auto subBlock = block.getSubBlock((size_t) start, (size_t) length);
+        
+        if (slopeCrossfade.remaining > 0)
+        {
+            for (size_t ch = 0; ch < slopeCrossfade.buffer.size(); ++ch)
+                std::copy(subBlock.getChannelPointer(ch), subBlock.getChannelPointer(ch) + length, slopeCrossfade.buffer[ch].begin());
+            
+            processChains(subBlock);
+            mixSlopeCrossfade(subBlock);
+        }
+        else
+        {
+            processChains(subBlock);
+        }
+    }
+}
+
+void ColinasEQAudioProcessor::startSlopeCrossfade()
+{
+    auto& fade = slopeCrossfade;
+    const auto sections = getSectionCoefficients(leftChain);
+    
+    for (size_t i = 0; i < sections.size(); ++i)
+        std::copy(sections[i], sections[i] + 5, fade.sections[i].begin());
+    
+    /** A fade still running is cut short. Slopes only switch once per pass of the morph amount, so it is rare */
+    fade.leftState = leftChainState;
+    fade.rightState = rightChainState;
+    fade.kernel = chainKernel;
+    fade.remaining = fade.length;
+    
+    /** Sections that weren't running hold state from whenever they last did, so the new chain starts from silence */
+    leftChainState.reset();
+    rightChainState.reset();
+}
+
+void ColinasEQAudioProcessor::mixSlopeCrossfade(juce::dsp::AudioBlock<float>& subBlock)
+{
+    auto& fade = slopeCrossfade;
+    const auto numSamples = (int) subBlock.getNumSamples();
+    jassert(numSamples <= SubBlockSize);
+    
+    ChainKernels::SectionCoefficients sections {};
+    for (size_t i = 0; i < sections.size(); ++i)
+        sections[i] = fade.sections[i].data();
+    
+    const std::array<ChainKernels::State*, 2> states { &fade.leftState, &fade.rightState };
+    const auto fadedSoFar = fade.length - fade.remaining;
+    
+    for (size_t ch = 0; ch < states.size(); ++ch)
+    {
+        auto* previous = fade.buffer[ch].data();
+        auto* samples = subBlock.getChannelPointer(ch);
+        
+        fade.kernel(sections, *states[ch], previous, numSamples);
+        
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto gain = juce::jmin(1.f, (float) (fadedSoFar + i + 1) / (float) fade.length);
+            samples[i] = previous[i] + (samples[i] - previous[i]) * gain;
+        }
+    }
+    
+    fade.remaining = juce::jmax(0, fade.remaining - numSamples);
+}
+
+void ColinasEQAudioProcessor::applyMorphedSettings(const ChainSettings& chainSettings)
+{
+    /** Only redesign the bands that differ between the snapshots */
+    const auto& last = lastMorphedSettings;
+    
+    const auto sampleRate = getSampleRate();
+    
+    /** A different kernel means sections start or stop running, which would click, so the outgoing chain is faded out */
+    auto kernel = ChainKernels::getKernel(chainSettings.lowCutSlope, chainSettings.highCutSlope,
+                                          chainSettings.lowCutBypassed, chainSettings.peakBypassed, chainSettings.highCutBypassed);
+    
+    if (kernel != chainKernel && chainsHaveRun)
+        startSlopeCrossfade();
+    
+    /** Runs every SubBlockSize samples while the amount moves, so the bands are designed in place rather than allocated */
+    if (morphNeedsFullUpdate || lowCutChanged(chainSettings, last))
+    {
+        designLowCutInPlace(leftChain, chainSettings, sampleRate);
+        designLowCutInPlace(rightChain, chainSettings, sampleRate);
+    }
+    
+    if (morphNeedsFullUpdate || peakChanged(chainSettings, last))
+    {
+        designPeakInPlace(leftChain, chainSettings, sampleRate);
+        designPeakInPlace(rightChain, chainSettings, sampleRate);
+    }
+    
+    if (morphNeedsFullUpdate || highCutChanged(chainSettings, last))
+    {
+        designHighCutInPlace(leftChain, chainSettings, sampleRate);
+        designHighCutInPlace(rightChain, chainSettings, sampleRate);
+    }
+    
+    selectChainKernel(chainSettings);
+    lastMorphedSettings = chainSettings;
+    morphNeedsFullUpdate = false;
+    
+    /** The cached designs have to be applied again once morphing stops */
+    markFiltersStale();
+}
+
+void ColinasEQAudioProcessor::updateAutoGain(const ChainSettings& chainSettings, bool peakIsDynamic)
+{
+    if (! autoGainNeedsUpdate && chainSettings == autoGainSettings)
+        return;
+    
+    /** The chains were just designed from chainSettings, so evaluate their sections rather than designing again */
+    const auto sections = getSectionCoefficients(leftChain);
+    
+    std::array<const float*, ChainKernels::NumSections> active {};
+    int numActive = 0;
+    
+    if (! chainSettings.lowCutBypassed)
+        for (int i = 0; i <= chainSettings.lowCutSlope; ++i)
+            active[(size_t) numActive++] = sections[(size_t) i];
+    
+    /** While the band is dynamic the chain holds the current dynamic gain, so take the static design instead */
+    const auto staticPeak = peakIsDynamic ? makePeakSection(chainSettings, getSampleRate()) : Biquad {};
+    
+    if (! chainSettings.peakBypassed)
+        active[(size_t) numActive++] = peakIsDynamic ? staticPeak.data() : sections[ChainKernels::PeakSection];
+    
+    if (! chainSettings.highCutBypassed)
+        for (int i = 0; i <= chainSettings.highCutSlope; ++i)
+            active[(size_t) numActive++] = sections[(size_t) (ChainKernels::HighCutSection + i)];
+    
+    autoGain.update(active.data(), numActive);
+    
+    autoGainSettings = chainSettings;
+    autoGainNeedsUpdate = false;
+}
+
+ChainSettings ColinasEQAudioProcessor::getEffectiveChainSettings()
+{
+    ChainSettings a, b;
+    
+    auto chainSettings = parameterBindings.getChainSettings();
+    
+    if (parameterBindings.getBool(Params::MorphEnabled) && snapshotBank.getMorphPair(a, b))
+    {
+        a.designMode = chainSettings.designMode;
+        b.designMode = chainSettings.designMode;
+        return interpolateChainSettings(a, b, parameterBindings.get(Params::Morph));
+    }
+    
+    return chainSettings;
+}
+
+void ColinasEQAudioProcessor::setChainSettings(const ChainSettings& chainSettings)
+{
+    auto setParameter = [this](Params::Index index, float value)
+    {
+        if (auto* parameter = apvts.getParameter(Params::ids[index]))
+        {
+            parameter->beginChangeGesture();
+            parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+            parameter->endChangeGesture();
+        }
+    };
+    
+    setParameter(Params::LowCutFreq, chainSettings.lowCutFreq);
+    setParameter(Params::LowCutSlope, (float) chainSettings.lowCutSlope);
+    setParameter(Params::LowCutBypassed, chainSettings.lowCutBypassed ? 1.f : 0.f);
+    setParameter(Params::PeakFreq, chainSettings.peakFreq);
+    setParameter(Params::PeakGain, chainSettings.peakGainDecibels);
+    setParameter(Params::PeakQuality, chainSettings.peakQuality);
+    setParameter(Params::PeakBypassed, chainSettings.peakBypassed ? 1.f : 0.f);
+    setParameter(Params::HighCutFreq, chainSettings.highCutFreq);
+    setParameter(Params::HighCutSlope, (float) chainSettings.highCutSlope);
+    setParameter(Params::HighCutBypassed, chainSettings.highCutBypassed ? 1.f : 0.f);
 }
 
 //==============================================================================
@@ -188,16 +755,245 @@ juce::AudioProcessorEditor* ColinasEQAudioProcessor::createEditor()
     //return new juce::GenericAudioProcessorEditor(*this);
 }
 
+ColinasEQAudioProcessor::AnalyzerFifos& ColinasEQAudioProcessor::acquireAnalyzerFifos()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    
+    if (numAnalyzerUsers++ == 0)
+        installAnalyzerFifos(analyzerFifos, preEqTapEnabled.load());
+    
+    leftRightCaptureWanted = numAnalyzerUsers > numPreEqUsers;
+    return *analyzerFifos;
+}
+
+ColinasEQAudioProcessor::AnalyzerFifos& ColinasEQAudioProcessor::acquireSpectrumFifos()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    jassert(spectrumFifos == nullptr);
+    
+    installAnalyzerFifos(spectrumFifos, false);
+    return *spectrumFifos;
+}
+
+void ColinasEQAudioProcessor::releaseSpectrumFifos()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    
+    std::unique_ptr<AnalyzerFifos> released;
+    
+    {
+        const juce::SpinLock::ScopedLockType lock(analyzerLock);
+        std::swap(released, spectrumFifos);
+    }
+}
+
+int ColinasEQAudioProcessor::getSpectrumSlot() const
+{
+    return spectrumPublisher->getSlot();
+}
+
+void ColinasEQAudioProcessor::installAnalyzerFifos(std::unique_ptr<AnalyzerFifos>& target, bool withPreEqTaps)
+{
+    /** Allocate outside the lock so the audio thread never waits on it */
+    auto fifos = std::make_unique<AnalyzerFifos>();
+    auto blockSize = maxBlockSize.load();
+    
+    auto sampleRate = getSampleRate();
+    
+    if (blockSize > 0)
+        fifos->prepare(blockSize, sampleRate, withPreEqTaps);
+    
+    const juce::SpinLock::ScopedLockType lock(analyzerLock);
+    
+    /** prepareToPlay ran in the meantime with a different block size or sample rate */
+    if (maxBlockSize.load() != blockSize || getSampleRate() != sampleRate)
+        fifos->prepare(maxBlockSize.load(), getSampleRate(), withPreEqTaps);
+    
+    target = std::move(fifos);
+}
+
+void ColinasEQAudioProcessor::releaseAnalyzerFifos()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    jassert(numAnalyzerUsers > 0);
+    
+    --numAnalyzerUsers;
+    leftRightCaptureWanted = numAnalyzerUsers > numPreEqUsers;
+    
+    if (numAnalyzerUsers == 0)
+    {
+        std::unique_ptr<AnalyzerFifos> released;
+        
+        {
+            const juce::SpinLock::ScopedLockType lock(analyzerLock);
+            std::swap(released, analyzerFifos);
+        }
+    }
+}
+
+void ColinasEQAudioProcessor::setMeteringEnabled(bool enabled)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    
+    if (enabled)
+        numMeterUsers.fetch_add(1);
+    else
+        numMeterUsers.fetch_sub(1);
+    
+    jassert(numMeterUsers.load() >= 0);
+}
+
+void ColinasEQAudioProcessor::setPreEqAnalyzerEnabled(bool enabled)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    
+    numPreEqUsers += enabled ? 1 : -1;
+    jassert(numPreEqUsers >= 0);
+    
+    /** The taps stay on for as long as any editor asks for them, and the views that didn't keep their left/right capture */
+    const bool tapsOn = numPreEqUsers > 0;
+    leftRightCaptureWanted = numAnalyzerUsers > numPreEqUsers;
+    
+    if (tapsOn == preEqTapEnabled.load())
+        return;
+    
+    /** The audio thread only ever tries this lock, so allocating under it never makes it wait */
+    const juce::SpinLock::ScopedLockType lock(analyzerLock);
+    
+    /** The pair is freed while the taps are off, and starts empty when they come back on */
+    if (analyzerFifos != nullptr && maxBlockSize.load() > 0)
+        analyzerFifos->preparePreEqTaps(maxBlockSize.load(), getSampleRate(), tapsOn);
+    
+    preEqTapEnabled = tapsOn;
+}
+
+MemoryFootprint ColinasEQAudioProcessor::getMemoryFootprint()
+{
+    MemoryFootprint footprint;
+    footprint.processor = sizeof(*this);
+    footprint.peakDynamics = peakDynamics.getNumBytes();
+    
+    const juce::SpinLock::ScopedLockType lock(analyzerLock);
+    
+    footprint.analyzerCapture = (size_t) (analyzerTapBuffer.getNumChannels() * analyzerTapBuffer.getNumSamples()) * sizeof(float);
+    
+    if (analyzerFifos != nullptr)
+        footprint.analyzerCapture += analyzerFifos->getNumBytes();
+    
+    footprint.spectrumPublishing = spectrumPublisher->getNumBytes();
+    
+    if (spectrumFifos != nullptr)
+        footprint.spectrumPublishing += spectrumFifos->getNumBytes();
+    
+    return footprint;
+}
+
+void ColinasEQAudioProcessor::AnalyzerFifos::prepare(int blockSize, double sampleRate, bool withPreEqTaps)
+{
+    auto capacity = getAnalyzerFifoCapacity(sampleRate, blockSize);
+    
+    leftChannelFifo.prepare(blockSize, capacity);
+    rightChannelFifo.prepare(blockSize, capacity);
+    
+    preparePreEqTaps(blockSize, sampleRate, withPreEqTaps);
+}
+
+void ColinasEQAudioProcessor::AnalyzerFifos::preparePreEqTaps(int blockSize, double sampleRate, bool enabled)
+{
+    if (enabled)
+    {
+        auto capacity = getAnalyzerFifoCapacity(sampleRate, blockSize);
+        preEqFifo.prepare(blockSize, capacity);
+        postEqFifo.prepare(blockSize, capacity);
+    }
+    else
+    {
+        preEqFifo.release();
+        postEqFifo.release();
+    }
+}
+
+size_t ColinasEQAudioProcessor::AnalyzerFifos::getNumBytes() const
+{
+    return sizeof(*this)
+         + leftChannelFifo.getNumBytes() + rightChannelFifo.getNumBytes()
+         + preEqFifo.getNumBytes() + postEqFifo.getNumBytes();
+}
+
 //==============================================================================
+namespace
+{
+    /** "CEQS" read as a little-endian int. States saved before the binary format
+        start with a ValueTree stream instead, which can never begin with these bytes */
+    constexpr int binaryStateMagic = 0x53514543;
+    constexpr int binaryStateVersion = 2;
+    
+    void writeChainSettings(juce::OutputStream& stream, const ChainSettings& settings)
+    {
+        stream.writeFloat(settings.peakFreq);
+        stream.writeFloat(settings.peakGainDecibels);
+        stream.writeFloat(settings.peakQuality);
+        stream.writeFloat(settings.lowCutFreq);
+        stream.writeFloat(settings.highCutFreq);
+        stream.writeByte((char) settings.lowCutSlope);
+        stream.writeByte((char) settings.highCutSlope);
+        stream.writeBool(settings.lowCutBypassed);
+        stream.writeBool(settings.peakBypassed);
+        stream.writeBool(settings.highCutBypassed);
+    }
+    
+    ChainSettings readChainSettings(juce::InputStream& stream)
+    {
+        ChainSettings settings;
+        settings.peakFreq = stream.readFloat();
+        settings.peakGainDecibels = stream.readFloat();
+        settings.peakQuality = stream.readFloat();
+        settings.lowCutFreq = stream.readFloat();
+        settings.highCutFreq = stream.readFloat();
+        settings.lowCutSlope = static_cast<Slope>(juce::jlimit(0, 3, (int) stream.readByte()));
+        settings.highCutSlope = static_cast<Slope>(juce::jlimit(0, 3, (int) stream.readByte()));
+        settings.lowCutBypassed = stream.readBool();
+        settings.peakBypassed = stream.readBool();
+        settings.highCutBypassed = stream.readBool();
+        return settings;
+    }
+}
+
+/** Binary state layout, all values little-endian:
+     int magic, int version, int numParameters,
+     then per parameter: int hash of the parameter ID, float normalised value.
+    Version 2 appends the snapshot bank */
 void ColinasEQAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
     juce::MemoryOutputStream mos(destData, true);
-    apvts.state.writeToStream(mos);
     
+    const auto& params = getParameters();
+    
+    mos.writeInt(binaryStateMagic);
+    mos.writeInt(binaryStateVersion);
+    mos.writeInt(params.size());
+    
+    for (auto* param : params)
+    {
+        auto* rap = dynamic_cast<juce::RangedAudioParameter*>(param);
+        jassert(rap != nullptr);
+        
+        mos.writeInt(rap->paramID.hashCode());
+        mos.writeFloat(rap->getValue());
+    }
+    
+    snapshotBank.writeToStream(mos);
 }
 
 void ColinasEQAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
+    if (readBinaryState(data, sizeInBytes))
+    {
+        updateFilters();
+        return;
+    }
+    
+    /** Older sessions store the whole ValueTree */
     auto tree = juce::ValueTree::readFromData(data, sizeInBytes);
     if (tree.isValid() )
     {
@@ -206,42 +1002,434 @@ void ColinasEQAudioProcessor::setStateInformation (const void* data, int sizeInB
     }
 }
 
+bool ColinasEQAudioProcessor::readBinaryState(const void* data, int sizeInBytes)
+{
+    juce::MemoryInputStream mis(data, (size_t) sizeInBytes, false);
+    
+    if (sizeInBytes < 3 * (int) sizeof(int) || mis.readInt() != binaryStateMagic)
+        return false;
+    
+    /** Newer versions only ever append to this layout, so the parameter block can still be read */
+    auto version = mis.readInt();
+    jassert(version <= binaryStateVersion);
+    
+    /** Parameters the blob doesn't mention, e.g. ones added after it was saved, go back to their defaults */
+    const auto& params = getParameters();
+    std::vector<float> values((size_t) params.size());
+    
+    for (auto* param : params)
+        values[(size_t) param->getParameterIndex()] = param->getDefaultValue();
+    
+    auto numStored = mis.readInt();
+    
+    for (int i = 0; i < numStored && mis.getNumBytesRemaining() >= 8; ++i)
+    {
+        auto idHash = mis.readInt();
+        auto value = mis.readFloat();
+        
+        auto found = parameterIndexByIdHash.find(idHash);
+        
+        /** jlimit lets NaN through, so anything that isn't finite keeps the default */
+        if (found != parameterIndexByIdHash.end() && std::isfinite(value))
+            values[(size_t) found->second] = juce::jlimit(0.f, 1.f, value);
+    }
+    
+    for (auto* param : params)
+        param->setValueNotifyingHost(values[(size_t) param->getParameterIndex()]);
+    
+    if (version >= 2)
+        snapshotBank.readFromStream(mis);
+    
+    return true;
+}
+
+
+void ParameterBindings::bind(juce::AudioProcessorValueTreeState& apvts)
+{
+    /** Params::Index has to follow the order of createParameterLayout */
+    jassert(apvts.processor.getParameters().size() == Params::NumParams);
+    
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        values[i] = apvts.getRawParameterValue(Params::ids[i]);
+        jassert(values[i] != nullptr);
+    }
+}
 
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
+ChainSettings ParameterBindings::getChainSettings() const
 {
     ChainSettings settings;
     
-    /**
-     @param the apvts.getRawParameterValue function gets the parameters values from the AudioProcessorValueTreeState
-            in units within the ranges defined by the parameters
-     */
-    settings.lowCutFreq = apvts.getRawParameterValue("LowCut Freq")->load();
-    settings.highCutFreq = apvts.getRawParameterValue("HighCut Freq")->load();
-    settings.peakFreq = apvts.getRawParameterValue("Peak Freq")->load();
-    settings.peakGainDecibels = apvts.getRawParameterValue("Peak Gain")->load();
-    settings.peakQuality = apvts.getRawParameterValue("Peak Quality")->load();
-    settings.lowCutSlope = static_cast<Slope> (apvts.getRawParameterValue("LowCut Slope")->load());
-    settings.highCutSlope = static_cast<Slope>(apvts.getRawParameterValue("HighCut Slope")->load());
-    
-    settings.lowCutBypassed = apvts.getRawParameterValue("LowCut Bypassed")->load() > 0.5f;
-    settings.peakBypassed = apvts.getRawParameterValue("Peak Bypassed")->load() > 0.5f;
-    settings.highCutBypassed = apvts.getRawParameterValue("HighCut Bypassed")->load() > 0.5f;
+    /** The raw values are in units within the ranges defined by the parameters */
+    settings.lowCutFreq = get(Params::LowCutFreq);
+    settings.highCutFreq = get(Params::HighCutFreq);
+    settings.peakFreq = get(Params::PeakFreq);
+    settings.peakGainDecibels = get(Params::PeakGain);
+    settings.peakQuality = get(Params::PeakQuality);
+    settings.lowCutSlope = static_cast<Slope>(get(Params::LowCutSlope));
+    settings.highCutSlope = static_cast<Slope>(get(Params::HighCutSlope));
+    
+    settings.lowCutBypassed = getBool(Params::LowCutBypassed);
+    settings.peakBypassed = getBool(Params::PeakBypassed);
+    settings.highCutBypassed = getBool(Params::HighCutBypassed);
+    
+    settings.designMode = static_cast<DesignMode>(get(Params::FilterDesign));
+
+    return settings;
+}
+
+PeakDynamicsSettings ParameterBindings::getPeakDynamicsSettings() const
+{
+    PeakDynamicsSettings settings;
+    
+    settings.enabled = getBool(Params::PeakDynamic);
+    settings.useSidechain = getBool(Params::PeakSidechain);
+    settings.thresholdDecibels = get(Params::PeakThreshold);
+    settings.ratio = get(Params::PeakRatio);
+    settings.attackMs = get(Params::PeakAttack);
+    settings.releaseMs = get(Params::PeakRelease);
+    
+    return settings;
+}
 
+ChainSettings interpolateChainSettings(const ChainSettings& a, const ChainSettings& b, float amount)
+{
+    if (amount <= 0.f)
+        return a;
+    if (amount >= 1.f)
+        return b;
+    
+    auto lerp = [amount](float x, float y) { return x + (y - x) * amount; };
+    auto logLerp = [amount](float x, float y) { return std::exp(std::log(x) + (std::log(y) - std::log(x)) * amount); };
+    
+    ChainSettings settings;
+    
+    /** A bypassed band morphs from a setting that does nothing, so it fades in rather than switching on */
+    settings.peakFreq = logLerp(a.peakFreq, b.peakFreq);
+    settings.peakQuality = logLerp(a.peakQuality, b.peakQuality);
+    settings.peakGainDecibels = lerp(a.peakBypassed ? 0.f : a.peakGainDecibels,
+                                     b.peakBypassed ? 0.f : b.peakGainDecibels);
+    settings.peakBypassed = a.peakBypassed && b.peakBypassed;
+    
+    settings.lowCutFreq = logLerp(a.lowCutBypassed ? 20.f : a.lowCutFreq,
+                                  b.lowCutBypassed ? 20.f : b.lowCutFreq);
+    settings.lowCutBypassed = a.lowCutBypassed && b.lowCutBypassed;
+    
+    settings.highCutFreq = logLerp(a.highCutBypassed ? 20000.f : a.highCutFreq,
+                                   b.highCutBypassed ? 20000.f : b.highCutFreq);
+    settings.highCutBypassed = a.highCutBypassed && b.highCutBypassed;
+    
+    /** The processor crossfades over the switch */
+    settings.lowCutSlope = amount < 0.5f ? a.lowCutSlope : b.lowCutSlope;
+    settings.highCutSlope = amount < 0.5f ? a.highCutSlope : b.highCutSlope;
+    settings.designMode = a.designMode;
+    
     return settings;
 }
 
+//==============================================================================
+void SnapshotBank::store(Snapshot target, const ChainSettings& settings)
+{
+    const juce::SpinLock::ScopedLockType sl(lock);
+    snapshots[target] = { settings, true };
+    ++version;
+}
+
+void SnapshotBank::storeSlot(int slot, const ChainSettings& settings)
+{
+    jassert(juce::isPositiveAndBelow(slot, NumSlots));
+    
+    const juce::SpinLock::ScopedLockType sl(lock);
+    slots[(size_t) slot] = { settings, true };
+    ++version;
+}
+
+bool SnapshotBank::recallSlot(int slot, Snapshot target)
+{
+    jassert(juce::isPositiveAndBelow(slot, NumSlots));
+    
+    const juce::SpinLock::ScopedLockType sl(lock);
+    if (! slots[(size_t) slot].stored)
+        return false;
+    
+    snapshots[target] = slots[(size_t) slot];
+    ++version;
+    return true;
+}
+
+bool SnapshotBank::isSlotStored(int slot) const
+{
+    const juce::SpinLock::ScopedLockType sl(lock);
+    return slots[(size_t) slot].stored;
+}
+
+bool SnapshotBank::getMorphPair(ChainSettings& a, ChainSettings& b) const
+{
+    const juce::SpinLock::ScopedLockType sl(lock);
+    if (! (snapshots[A].stored && snapshots[B].stored))
+        return false;
+    
+    a = snapshots[A].settings;
+    b = snapshots[B].settings;
+    return true;
+}
+
+bool SnapshotBank::tryCopyMorphPair(ChainSettings& a, ChainSettings& b, bool& bothStored) const
+{
+    const juce::SpinLock::ScopedTryLockType sl(lock);
+    if (! sl.isLocked())
+        return false;
+    
+    a = snapshots[A].settings;
+    b = snapshots[B].settings;
+    bothStored = snapshots[A].stored && snapshots[B].stored;
+    return true;
+}
+
+void SnapshotBank::writeToStream(juce::OutputStream& stream) const
+{
+    const juce::SpinLock::ScopedLockType sl(lock);
+    
+    stream.writeInt((int) (snapshots.size() + slots.size()));
+    
+    auto writeEntry = [&stream](const Entry& entry)
+    {
+        stream.writeBool(entry.stored);
+        writeChainSettings(stream, entry.settings);
+    };
+    
+    for (const auto& entry : snapshots)
+        writeEntry(entry);
+    
+    for (const auto& entry : slots)
+        writeEntry(entry);
+}
+
+void SnapshotBank::readFromStream(juce::InputStream& stream)
+{
+    auto numStored = stream.readInt();
+    
+    const juce::SpinLock::ScopedLockType sl(lock);
+    
+    for (int i = 0; i < numStored && ! stream.isExhausted(); ++i)
+    {
+        Entry entry;
+        entry.stored = stream.readBool();
+        entry.settings = readChainSettings(stream);
+        
+        if (i < (int) snapshots.size())
+            snapshots[(size_t) i] = entry;
+        else if (i - (int) snapshots.size() < NumSlots)
+            slots[(size_t) (i - (int) snapshots.size())] = entry;
+    }
+    
+    ++version;
+}
+
 
 Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate)
 {
+    if (chainSettings.designMode == Design_Matched)
+        return MatchedDesign::toCoefficients(MatchedDesign::makePeak(sampleRate,
+                                                                     clampDesignFrequency(chainSettings.peakFreq, sampleRate),
+                                                                     chainSettings.peakQuality,
+                                                                     juce::Decibels::decibelsToGain(chainSettings.peakGainDecibels)));
+    
     return juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate,
-                                                               chainSettings.peakFreq,
+                                                               clampDesignFrequency(chainSettings.peakFreq, sampleRate),
                                                                chainSettings.peakQuality,
                                                                juce::Decibels::decibelsToGain(chainSettings.peakGainDecibels));
 }
 
+namespace
+{
+    void writeSection(Filter& filter, const Biquad& biquad)
+    {
+        jassert(filter.coefficients->coefficients.size() == (int) biquad.size());
+        std::copy(biquad.begin(), biquad.end(), filter.coefficients->getRawCoefficients());
+    }
+    
+    /** The Butterworth cascade of juce::dsp::FilterDesign, one section per slope step, with the same Qs in the same order */
+    template<typename SectionDesign>
+    void designCutInPlace(CutFilter& cut, Slope slope, SectionDesign&& design)
+    {
+        const auto order = 2 * (slope + 1);
+        
+        auto designStage = [&](Filter& filter, int stage)
+        {
+            auto quality = 1.0 / (2.0 * std::cos((2.0 * stage + 1.0) * juce::MathConstants<double>::pi / (order * 2.0)));
+            writeSection(filter, design(quality));
+        };
+        
+        cut.setBypassed<0>(true);
+        cut.setBypassed<1>(true);
+        cut.setBypassed<2>(true);
+        cut.setBypassed<3>(true);
+        
+        switch (slope)
+        {
+            case Slope_48:
+                designStage(cut.get<3>(), 3);
+                cut.setBypassed<3>(false);
+                [[fallthrough]];
+            case Slope_36:
+                designStage(cut.get<2>(), 2);
+                cut.setBypassed<2>(false);
+                [[fallthrough]];
+            case Slope_24:
+                designStage(cut.get<1>(), 1);
+                cut.setBypassed<1>(false);
+                [[fallthrough]];
+            case Slope_12:
+                designStage(cut.get<0>(), 0);
+                cut.setBypassed<0>(false);
+                break;
+        }
+    }
+}
+
+void makeSecondOrderSections(MonoChain& chain)
+{
+    auto makeSection = [](Filter& filter) { filter.coefficients = new juce::dsp::IIR::Coefficients<float>(1, 0, 0, 1, 0, 0); };
+    
+    auto makeCutSections = [&](CutFilter& cut)
+    {
+        makeSection(cut.get<0>());
+        makeSection(cut.get<1>());
+        makeSection(cut.get<2>());
+        makeSection(cut.get<3>());
+    };
+    
+    makeCutSections(chain.get<ChainPositions::LowCut>());
+    makeSection(chain.get<ChainPositions::Peak>());
+    makeCutSections(chain.get<ChainPositions::HighCut>());
+}
+
+void designLowCutInPlace(MonoChain& chain, const ChainSettings& chainSettings, double sampleRate)
+{
+    const auto frequency = (double) clampDesignFrequency(chainSettings.lowCutFreq, sampleRate);
+    const bool matched = chainSettings.designMode == Design_Matched;
+    
+    chain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
+    designCutInPlace(chain.get<ChainPositions::LowCut>(), chainSettings.lowCutSlope, [&](double quality)
+    {
+        return matched ? MatchedDesign::makeHighPass(sampleRate, frequency, quality)
+                       : BilinearDesign::makeHighPass(sampleRate, frequency, quality);
+    });
+}
+
+void designPeakInPlace(MonoChain& chain, const ChainSettings& chainSettings, double sampleRate)
+{
+    chain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
+    writeSection(chain.get<ChainPositions::Peak>(), makePeakSection(chainSettings, sampleRate));
+}
+
+void designHighCutInPlace(MonoChain& chain, const ChainSettings& chainSettings, double sampleRate)
+{
+    const auto frequency = (double) clampDesignFrequency(chainSettings.highCutFreq, sampleRate);
+    const bool matched = chainSettings.designMode == Design_Matched;
+    
+    chain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+    designCutInPlace(chain.get<ChainPositions::HighCut>(), chainSettings.highCutSlope, [&](double quality)
+    {
+        return matched ? MatchedDesign::makeLowPass(sampleRate, frequency, quality)
+                       : BilinearDesign::makeLowPass(sampleRate, frequency, quality);
+    });
+}
+
+double getChainMagnitudeForFrequency(const MonoChain& chain, double frequency, double sampleRate)
+{
+    double magnitude = 1.0;
+    
+    auto cutMagnitude = [&](const CutFilter& cut)
+    {
+        double m = 1.0;
+        
+        if (! cut.isBypassed<0>())
+            m *= cut.get<0>().coefficients->getMagnitudeForFrequency(frequency, sampleRate);
+        if (! cut.isBypassed<1>())
+            m *= cut.get<1>().coefficients->getMagnitudeForFrequency(frequency, sampleRate);
+        if (! cut.isBypassed<2>())
+            m *= cut.get<2>().coefficients->getMagnitudeForFrequency(frequency, sampleRate);
+        if (! cut.isBypassed<3>())
+            m *= cut.get<3>().coefficients->getMagnitudeForFrequency(frequency, sampleRate);
+        
+        return m;
+    };
+    
+    if (! chain.isBypassed<ChainPositions::Peak>())
+        magnitude *= chain.get<ChainPositions::Peak>().coefficients->getMagnitudeForFrequency(frequency, sampleRate);
+    
+    if (! chain.isBypassed<ChainPositions::LowCut>())
+        magnitude *= cutMagnitude(chain.get<ChainPositions::LowCut>());
+    
+    if (! chain.isBypassed<ChainPositions::HighCut>())
+        magnitude *= cutMagnitude(chain.get<ChainPositions::HighCut>());
+    
+    return magnitude;
+}
+
+ChainKernels::SectionCoefficients getSectionCoefficients(MonoChain& chain)
+{
+    auto& lowCut = chain.get<ChainPositions::LowCut>();
+    auto& highCut = chain.get<ChainPositions::HighCut>();
+    
+    return { lowCut.get<0>().coefficients->getRawCoefficients(),
+             lowCut.get<1>().coefficients->getRawCoefficients(),
+             lowCut.get<2>().coefficients->getRawCoefficients(),
+             lowCut.get<3>().coefficients->getRawCoefficients(),
+             chain.get<ChainPositions::Peak>().coefficients->getRawCoefficients(),
+             highCut.get<0>().coefficients->getRawCoefficients(),
+             highCut.get<1>().coefficients->getRawCoefficients(),
+             highCut.get<2>().coefficients->getRawCoefficients(),
+             highCut.get<3>().coefficients->getRawCoefficients() };
+}
+
+CoefficientSetPtr getPeakCoefficients(CoefficientCache& cache, const ChainSettings& chainSettings, double sampleRate)
+{
+    CoefficientKey key;
+    key.band = ChainPositions::Peak;
+    key.freq = chainSettings.peakFreq;
+    key.quality = chainSettings.peakQuality;
+    key.gainDecibels = chainSettings.peakGainDecibels;
+    key.design = chainSettings.designMode;
+    key.sampleRate = sampleRate;
+
+    return cache.getOrDesign(key, [&]
+    {
+        CoefficientSet set;
+        set.add(makePeakFilter(chainSettings, sampleRate));
+        return set;
+    });
+}
+
+CoefficientSetPtr getLowCutCoefficients(CoefficientCache& cache, const ChainSettings& chainSettings, double sampleRate)
+{
+    CoefficientKey key;
+    key.band = ChainPositions::LowCut;
+    key.freq = chainSettings.lowCutFreq;
+    key.slope = chainSettings.lowCutSlope;
+    key.design = chainSettings.designMode;
+    key.sampleRate = sampleRate;
+
+    return cache.getOrDesign(key, [&] { return makeLowCutFilter(chainSettings, sampleRate); });
+}
+
+CoefficientSetPtr getHighCutCoefficients(CoefficientCache& cache, const ChainSettings& chainSettings, double sampleRate)
+{
+    CoefficientKey key;
+    key.band = ChainPositions::HighCut;
+    key.freq = chainSettings.highCutFreq;
+    key.slope = chainSettings.highCutSlope;
+    key.design = chainSettings.designMode;
+    key.sampleRate = sampleRate;
+
+    return cache.getOrDesign(key, [&] { return makeHighCutFilter(chainSettings, sampleRate); });
+}
+
 void ColinasEQAudioProcessor::updatePeakFilter(const ChainSettings &chainSettings)
 {
-    auto peakCoefficients = makePeakFilter(chainSettings, getSampleRate());
+    auto peakCoefficients = (*getPeakCoefficients(*coefficientCache, chainSettings, getSampleRate()))[0];
     
     leftChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
     rightChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
@@ -259,14 +1447,10 @@ void updateCoefficients(Coefficients &old, const Coefficients &replacements)
 
 void ColinasEQAudioProcessor::updateLowCutFilters(const ChainSettings &chainSettings)
 {
-    // Check if the low-cut frequency is valid
-//    if (chainSettings.lowCutFreq <= 0 || chainSettings.lowCutFreq > getSampleRate() * 0.5)
-//    {
-//        DBG("Low cut frequency out of range: " << chainSettings.lowCutFreq);
-//        return; // Exit the function if the frequency is out of range
-//    }
-
-    auto cutCoefficients = makeLowCutFilter(chainSettings, getSampleRate());
+    /** makeLowCutFilter clamps the frequency to what the sample rate allows */
+    auto cached = getLowCutCoefficients(*coefficientCache, chainSettings, getSampleRate());
+    
+    const auto& cutCoefficients = *cached;
     auto& leftLowCut = leftChain.get<ChainPositions::LowCut>();
     auto& rightLowCut = rightChain.get<ChainPositions::LowCut>();
     
@@ -281,14 +1465,10 @@ void ColinasEQAudioProcessor::updateLowCutFilters(const ChainSettings &chainSett
 
 void ColinasEQAudioProcessor::updateHighCutFilters(const ChainSettings &chainSettings)
 {
-//    // Check if the high-cut frequency is valid
-//    if (chainSettings.highCutFreq <= 0 || chainSettings.highCutFreq > getSampleRate() * 0.5)
-//    {
-//        DBG("High cut frequency out of range: " << chainSettings.highCutFreq);
-//        return; // Exit the function if the frequency is out of range
-//    }
-
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, getSampleRate());
+    /** makeHighCutFilter clamps the frequency to what the sample rate allows */
+    auto cached = getHighCutCoefficients(*coefficientCache, chainSettings, getSampleRate());
+    
+    const auto& highCutCoefficients = *cached;
     auto& leftHighCut = leftChain.get<ChainPositions::HighCut>();
     auto& rightHighCut = rightChain.get<ChainPositions::HighCut>();
     
@@ -304,12 +1484,25 @@ void ColinasEQAudioProcessor::updateHighCutFilters(const ChainSettings &chainSet
 
 void ColinasEQAudioProcessor::updateFilters()
 {
-    auto chainSettings = getChainSettings(apvts);
+    updateFilters(parameterBindings.getChainSettings());
+}
+
+void ColinasEQAudioProcessor::updateFilters(const ChainSettings& chainSettings)
+{
+    /** The cache is shared by every instance, so a block that changes nothing doesn't take its lock */
+    if (lowCutStale || lowCutChanged(chainSettings, appliedSettings))
+        updateLowCutFilters(chainSettings);
+    
+    if (peakStale || peakChanged(chainSettings, appliedSettings))
+        updatePeakFilter(chainSettings);
     
-    updateLowCutFilters(chainSettings);
-    updatePeakFilter(chainSettings);
-    updateHighCutFilters(chainSettings);
+    if (highCutStale || highCutChanged(chainSettings, appliedSettings))
+        updateHighCutFilters(chainSettings);
     
+    appliedSettings = chainSettings;
+    lowCutStale = peakStale = highCutStale = false;
+    
+    selectChainKernel(chainSettings);
 }
 
 /** Declaration of the apvts object.
@@ -320,25 +1513,25 @@ juce::AudioProcessorValueTreeState::ParameterLayout ColinasEQAudioProcessor::cre
     /** The AudioParameterFloat is a derived type juce class that represents the sliders on the GUI.
         @see juce::NormalisableRange
      */
-    layout.add(std::make_unique<juce::AudioParameterFloat>("LowCut Freq",
-                                                           "LowCut Freq",
+    layout.add(std::make_unique<juce::AudioParameterFloat>(Params::ids[Params::LowCutFreq],
+                                                           Params::ids[Params::LowCutFreq],
                                                            /** Sets the frequency range and the changes the value of the sliders,  */
                                                            juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f), 20.f));
     
-    layout.add(std::make_unique<juce::AudioParameterFloat>("HighCut Freq",
-                                                           "HighCut Freq",
+    layout.add(std::make_unique<juce::AudioParameterFloat>(Params::ids[Params::HighCutFreq],
+                                                           Params::ids[Params::HighCutFreq],
                                                            juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f), 20000.f));
     
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak Freq",
-                                                           "Peak Freq",
+    layout.add(std::make_unique<juce::AudioParameterFloat>(Params::ids[Params::PeakFreq],
+                                                           Params::ids[Params::PeakFreq],
                                                            juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f), 750.f));
     
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak Gain",
-                                                           "Peak Gain",
+    layout.add(std::make_unique<juce::AudioParameterFloat>(Params::ids[Params::PeakGain],
+                                                           Params::ids[Params::PeakGain],
                                                            juce::NormalisableRange<float>(-24.f, 24.f, 0.5f, 1.f), 0.0f));
     
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak Quality",
-                                                           "Peak Quality",
+    layout.add(std::make_unique<juce::AudioParameterFloat>(Params::ids[Params::PeakQuality],
+                                                           Params::ids[Params::PeakQuality],
                                                            juce::NormalisableRange<float>(0.1f, 10.f, 0.05f, 1.f), 1.f));
     /** Creation of a string array
      @see AudioParameterChoice */
@@ -353,14 +1546,52 @@ juce::AudioProcessorValueTreeState::ParameterLayout ColinasEQAudioProcessor::cre
     
     /** The slope cutoff is measured in decibles of gain reduction per octave, therefore, the AudioParameterChoice was necessary since it was needed
      to choose between 4 options instead of a frequecy range values like the above parameters */
-    layout.add(std::make_unique<juce::AudioParameterChoice>("LowCut Slope", "LowCut Slope", stringArray, 0));
-    layout.add(std::make_unique<juce::AudioParameterChoice>("HighCut Slope", "HighCut Slope", stringArray, 0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>(Params::ids[Params::LowCutSlope], Params::ids[Params::LowCutSlope], stringArray, 0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>(Params::ids[Params::HighCutSlope], Params::ids[Params::HighCutSlope], stringArray, 0));
 
     
-    layout.add(std::make_unique<juce::AudioParameterBool>("LowCut Bypassed", "LowCut Bypassed", false));
-    layout.add(std::make_unique<juce::AudioParameterBool>("Peak Bypassed", "Peak Bypassed", false));
-    layout.add(std::make_unique<juce::AudioParameterBool>("HighCut Bypassed", "HighCut Bypassed", false));
-    layout.add(std::make_unique<juce::AudioParameterBool>("Analyzer Enable", "Analyzer Enable", true));
+    layout.add(std::make_unique<juce::AudioParameterBool>(Params::ids[Params::LowCutBypassed], Params::ids[Params::LowCutBypassed], false));
+    layout.add(std::make_unique<juce::AudioParameterBool>(Params::ids[Params::PeakBypassed], Params::ids[Params::PeakBypassed], false));
+    layout.add(std::make_unique<juce::AudioParameterBool>(Params::ids[Params::HighCutBypassed], Params::ids[Params::HighCutBypassed], false));
+    layout.add(std::make_unique<juce::AudioParameterBool>(Params::ids[Params::AnalyzerEnabled], Params::ids[Params::AnalyzerEnabled], true));
+    
+    /** Blends between the A and B snapshots while "Morph Enabled" is on */
+    layout.add(std::make_unique<juce::AudioParameterFloat>(Params::ids[Params::Morph],
+                                                           Params::ids[Params::Morph],
+                                                           juce::NormalisableRange<float>(0.f, 1.f, 0.001f, 1.f), 0.f));
+    layout.add(std::make_unique<juce::AudioParameterBool>(Params::ids[Params::MorphEnabled], Params::ids[Params::MorphEnabled], false));
+    
+    /** Dynamic mode of the peak band. Above the threshold the band's gain is pulled down from "Peak Gain" */
+    layout.add(std::make_unique<juce::AudioParameterBool>(Params::ids[Params::PeakDynamic], Params::ids[Params::PeakDynamic], false));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>(Params::ids[Params::PeakThreshold],
+                                                           Params::ids[Params::PeakThreshold],
+                                                           juce::NormalisableRange<float>(-60.f, 0.f, 0.5f, 1.f), -20.f));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>(Params::ids[Params::PeakRatio],
+                                                           Params::ids[Params::PeakRatio],
+                                                           juce::NormalisableRange<float>(1.f, 20.f, 0.1f, 0.5f), 2.f));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>(Params::ids[Params::PeakAttack],
+                                                           Params::ids[Params::PeakAttack],
+                                                           juce::NormalisableRange<float>(0.1f, 100.f, 0.1f, 0.5f), 10.f));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>(Params::ids[Params::PeakRelease],
+                                                           Params::ids[Params::PeakRelease],
+                                                           juce::NormalisableRange<float>(5.f, 1000.f, 1.f, 0.5f), 100.f));
+    
+    layout.add(std::make_unique<juce::AudioParameterBool>(Params::ids[Params::PeakSidechain], Params::ids[Params::PeakSidechain], false));
+    
+    /** Matched designs follow the analog response up to Nyquist instead of cramping like the bilinear ones */
+    layout.add(std::make_unique<juce::AudioParameterChoice>(Params::ids[Params::FilterDesign],
+                                                            Params::ids[Params::FilterDesign],
+                                                            juce::StringArray { "Bilinear", "Matched" }, 0));
+    
+    /** Opt-in, and only used while the host renders offline */
+    layout.add(std::make_unique<juce::AudioParameterBool>(Params::ids[Params::ParallelRender], Params::ids[Params::ParallelRender], false));
+    
+    /** Keeps the pink-noise loudness of the output level with the input, worked out from the response curve */
+    layout.add(std::make_unique<juce::AudioParameterBool>(Params::ids[Params::AutoGain], Params::ids[Params::AutoGain], false));
 
 
 
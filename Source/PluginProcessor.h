@@ -3,11 +3,36 @@
 #include <JuceHeader.h>
 
 #include <array>
+#include <unordered_map>
+
+#include "AutoGain.h"
+#include "BilinearDesign.h"
+#include "ChainKernels.h"
+#include "ChannelWorkers.h"
+#include "CoefficientCache.h"
+#include "LevelMeter.h"
+#include "MatchedDesign.h"
+#include "PeakDynamics.h"
+#include "TestSignal.h"
+
+class SpectrumPublisher;
 
 
 template<typename T>
 struct Fifo
 {
+    // Sets how many items the Fifo can hold, dropping everything in it. Call before prepare
+    void setCapacity(int numItems)
+    {
+        jassert(numItems > 0);
+        
+        // AbstractFifo always keeps one slot free
+        std::vector<T>((size_t) numItems + 1).swap(buffers);
+        fifo.setTotalSize(numItems + 1);
+    }
+    
+    int getCapacity() const { return fifo.getTotalSize() - 1; }
+    
     void prepare(int numChannels, int numSamples)
     {
         static_assert( std::is_same_v<T, juce::AudioBuffer<float>>,
@@ -62,12 +87,41 @@ struct Fifo
     {
         return fifo.getNumReady();
     }
+    
+    // Memory held by the slots and their contents
+    size_t getNumBytes() const
+    {
+        auto bytes = buffers.capacity() * sizeof(T);
+        
+        for( const auto& buffer : buffers )
+        {
+            if constexpr (std::is_same_v<T, juce::AudioBuffer<float>>)
+                bytes += (size_t) (buffer.getNumChannels() * buffer.getNumSamples()) * sizeof(float);
+            else if constexpr (std::is_same_v<T, std::vector<float>>)
+                bytes += buffer.capacity() * sizeof(float);
+        }
+        
+        return bytes;
+    }
 private:
-    static constexpr int Capacity = 30;
-    std::array<T, Capacity> buffers;
-    juce::AbstractFifo fifo {Capacity};
+    static constexpr int DefaultCapacity = 30;
+    std::vector<T> buffers = std::vector<T>(DefaultCapacity);
+    juce::AbstractFifo fifo {DefaultCapacity};
 };
 
+// The editor reads the analyzer at least this often, even at its idle rate
+inline constexpr int AnalyzerMinReadRateHz = 10;
+
+// Enough slots for everything produced between two reads at the slowest read rate, plus two items of slack
+inline int getAnalyzerFifoCapacity(double sampleRate, int samplesPerItem)
+{
+    if( sampleRate <= 0.0 || samplesPerItem <= 0 )
+        return 4;
+    
+    auto itemsPerRead = (int) std::ceil(sampleRate / AnalyzerMinReadRateHz / samplesPerItem);
+    return juce::jlimit(4, 256, itemsPerRead + 2);
+}
+
 
 
 enum Channel
@@ -96,7 +150,8 @@ struct SingleChannelSampleFifo
         }
     }
 
-    void prepare(int bufferSize)
+    /** numBuffers is the FIFO's capacity, see getAnalyzerFifoCapacity */
+    void prepare(int bufferSize, int numBuffers)
     {
         prepared.set(false);
         size.set(bufferSize);
@@ -106,14 +161,34 @@ struct SingleChannelSampleFifo
                              false,         //keepExistingContent
                              true,          //clear extra space
                              true);         //avoid reallocating
+        
+        if (audioBufferFifo.getCapacity() != numBuffers)
+            audioBufferFifo.setCapacity(numBuffers);
+        
         audioBufferFifo.prepare(1, bufferSize);
         fifoIndex = 0;
         prepared.set(true);
     }
+    
+    /** Frees every buffer. prepare has to be called again before the next update */
+    void release()
+    {
+        prepared.set(false);
+        size.set(0);
+        
+        bufferToFill = BlockType();
+        audioBufferFifo.setCapacity(1);
+        fifoIndex = 0;
+    }
+
     //==============================================================================
     int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
     bool isPrepared() const { return prepared.get(); }
     int getSize() const { return size.get(); }
+    size_t getNumBytes() const
+    {
+        return audioBufferFifo.getNumBytes() + (size_t) bufferToFill.getNumSamples() * sizeof(float);
+    }
     //==============================================================================
     bool getAudioBuffer(BlockType& buf) { return audioBufferFifo.pull(buf); }
 private:
@@ -151,6 +226,13 @@ enum Slope
     Slope_48
 };
 
+// How the band coefficients are designed from their analog prototypes
+enum DesignMode
+{
+    Design_Bilinear,
+    Design_Matched
+};
+
 // Struct to hold filter settings
 struct ChainSettings
 {
@@ -160,10 +242,144 @@ struct ChainSettings
     //~ChainSettings() {}
     
     bool lowCutBypassed { false }, peakBypassed { false }, highCutBypassed { false };
+    
+    // Global rather than per snapshot, so morphing never blends between designs
+    DesignMode designMode { DesignMode::Design_Bilinear };
+    
+    bool operator== (const ChainSettings& other) const
+    {
+        return peakFreq == other.peakFreq && peakGainDecibels == other.peakGainDecibels && peakQuality == other.peakQuality
+            && lowCutFreq == other.lowCutFreq && highCutFreq == other.highCutFreq
+            && lowCutSlope == other.lowCutSlope && highCutSlope == other.highCutSlope
+            && lowCutBypassed == other.lowCutBypassed && peakBypassed == other.peakBypassed && highCutBypassed == other.highCutBypassed
+            && designMode == other.designMode;
+    }
+    
+    bool operator!= (const ChainSettings& other) const { return ! (*this == other); }
+};
+
+// Every parameter, in the order createParameterLayout adds them
+namespace Params
+{
+    enum Index
+    {
+        LowCutFreq,
+        HighCutFreq,
+        PeakFreq,
+        PeakGain,
+        PeakQuality,
+        LowCutSlope,
+        HighCutSlope,
+        LowCutBypassed,
+        PeakBypassed,
+        HighCutBypassed,
+        AnalyzerEnabled,
+        Morph,
+        MorphEnabled,
+        PeakDynamic,
+        PeakThreshold,
+        PeakRatio,
+        PeakAttack,
+        PeakRelease,
+        PeakSidechain,
+        FilterDesign,
+        ParallelRender,
+        AutoGain,
+        NumParams
+    };
+    
+    // Parameter IDs as stored in sessions, indexed by Params::Index
+    inline constexpr std::array<const char*, NumParams> ids
+    {
+        "LowCut Freq",
+        "HighCut Freq",
+        "Peak Freq",
+        "Peak Gain",
+        "Peak Quality",
+        "LowCut Slope",
+        "HighCut Slope",
+        "LowCut Bypassed",
+        "Peak Bypassed",
+        "HighCut Bypassed",
+        "Analyzer Enable",
+        "Morph",
+        "Morph Enabled",
+        "Peak Dynamic",
+        "Peak Threshold",
+        "Peak Ratio",
+        "Peak Attack",
+        "Peak Release",
+        "Peak Sidechain",
+        "Filter Design",
+        "Parallel Render",
+        "Auto Gain"
+    };
+}
+
+/**
+ The raw value of every parameter, looked up once by ID when the processor is constructed.
+ Reading a snapshot of the parameters is then a handful of relaxed atomic loads.
+ */
+struct ParameterBindings
+{
+    void bind(juce::AudioProcessorValueTreeState& apvts);
+    
+    float get(Params::Index index) const { return values[index]->load(std::memory_order_relaxed); }
+    bool getBool(Params::Index index) const { return get(index) > 0.5f; }
+    
+    // Functions to get the current settings of the filter chain and the dynamic peak band
+    ChainSettings getChainSettings() const;
+    PeakDynamicsSettings getPeakDynamicsSettings() const;
+    
+private:
+    std::array<std::atomic<float>*, Params::NumParams> values {};
 };
 
-// Function to get the current chain settings from AudioProcessorValueTreeState
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
+// Blends two settings perceptually: frequencies and Q on a log scale, gains in dB.
+// Slopes switch half way, bypassed bands fade in from a neutral setting
+ChainSettings interpolateChainSettings(const ChainSettings& a, const ChainSettings& b, float amount);
+
+/**
+ A and B snapshots of ChainSettings that the "Morph" parameter blends between, plus NumSlots storage slots.
+ Written from the message thread. The audio thread only copies it out with a try-lock.
+ */
+struct SnapshotBank
+{
+    static constexpr int NumSlots = 8;
+    
+    enum Snapshot
+    {
+        A,
+        B
+    };
+    
+    void store(Snapshot target, const ChainSettings& settings);
+    void storeSlot(int slot, const ChainSettings& settings);
+    /** Copies a stored slot into A or B. Returns false if nothing was stored in the slot */
+    bool recallSlot(int slot, Snapshot target);
+    bool isSlotStored(int slot) const;
+    
+    /** Returns the morph source settings if both A and B have been stored */
+    bool getMorphPair(ChainSettings& a, ChainSettings& b) const;
+    /** Audio thread version of getMorphPair. Returns false without touching a or b if the bank is being written */
+    bool tryCopyMorphPair(ChainSettings& a, ChainSettings& b, bool& bothStored) const;
+    /** Incremented on every change so readers know when to copy again */
+    int getVersion() const { return version.load(); }
+    
+    void writeToStream(juce::OutputStream& stream) const;
+    void readFromStream(juce::InputStream& stream);
+private:
+    struct Entry
+    {
+        ChainSettings settings;
+        bool stored { false };
+    };
+    
+    std::array<Entry, 2> snapshots;
+    std::array<Entry, NumSlots> slots;
+    std::atomic<int> version { 0 };
+    mutable juce::SpinLock lock;
+};
 
 // Filter alias for mono chain
 using Filter = juce::dsp::IIR::Filter<float>;
@@ -202,35 +418,100 @@ void updateCutFilter(ChainType& chain, const CoefficientType& coefficients, cons
     chain.template setBypassed<2>(true);
     chain.template setBypassed<3>(true);
 
+    // Each slope step adds a stage, so fall through to enable every stage below it
     switch (slope)
     {
         case Slope_48:
             update<3>(chain, coefficients);
-            break;
+            [[fallthrough]];
         case Slope_36:
             update<2>(chain, coefficients);
-            break;
+            [[fallthrough]];
         case Slope_24:
             update<1>(chain, coefficients);
-            break;
+            [[fallthrough]];
         case Slope_12:
             update<0>(chain, coefficients);
             break;
     }
 }
 
+// Highest frequency, as a fraction of the sample rate, that any band is designed at.
+// The parameter ranges go up to 20 kHz, which is past Nyquist at 32 kHz and where the bilinear designs fall apart near it
+inline constexpr double MaxDesignFrequencyRatio = 0.45;
+
+// Clamps a band frequency to what can be designed at sampleRate
+inline float clampDesignFrequency(float frequency, double sampleRate)
+{
+    if (sampleRate <= 0.0)
+        return frequency;
+    
+    return juce::jlimit(1.f, (float) (sampleRate * MaxDesignFrequencyRatio), frequency);
+}
+
 // Function to create a low-cut filter
 inline auto makeLowCutFilter(const ChainSettings& chainSettings, double sampleRate)
 {
-    return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(chainSettings.lowCutFreq, sampleRate, 2 * (chainSettings.lowCutSlope + 1));
+    auto frequency = clampDesignFrequency(chainSettings.lowCutFreq, sampleRate);
+    
+    if (chainSettings.designMode == Design_Matched)
+        return MatchedDesign::makeHighOrderHighPass(frequency, sampleRate, 2 * (chainSettings.lowCutSlope + 1));
+    
+    return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(frequency, sampleRate, 2 * (chainSettings.lowCutSlope + 1));
 }
 
 // Function to create a high-cut filter
 inline auto makeHighCutFilter(const ChainSettings& chainSettings, double sampleRate)
 {
-    return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(chainSettings.highCutFreq, sampleRate, 2 * (chainSettings.highCutSlope + 1));
+    auto frequency = clampDesignFrequency(chainSettings.highCutFreq, sampleRate);
+    
+    if (chainSettings.designMode == Design_Matched)
+        return MatchedDesign::makeHighOrderLowPass(frequency, sampleRate, 2 * (chainSettings.highCutSlope + 1));
+    
+    return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(frequency, sampleRate, 2 * (chainSettings.highCutSlope + 1));
 }
 
+// Gives every section of a chain its own second order coefficients, so the in-place designs below never have to resize them
+void makeSecondOrderSections(MonoChain& chain);
+
+// Realtime safe versions of the designs above. They write a band straight into the chain's existing sections
+// and set its bypass states, without allocating. The chain must have been through makeSecondOrderSections
+void designLowCutInPlace(MonoChain& chain, const ChainSettings& chainSettings, double sampleRate);
+void designPeakInPlace(MonoChain& chain, const ChainSettings& chainSettings, double sampleRate);
+void designHighCutInPlace(MonoChain& chain, const ChainSettings& chainSettings, double sampleRate);
+
+// Linear gain of a chain at one frequency, skipping bypassed bands and stages
+double getChainMagnitudeForFrequency(const MonoChain& chain, double frequency, double sampleRate);
+
+// The raw coefficients of every section of a chain, in ChainKernels section order
+ChainKernels::SectionCoefficients getSectionCoefficients(MonoChain& chain);
+
+// Cached versions of the designs above, shared by every instance in the process
+CoefficientSetPtr getPeakCoefficients(CoefficientCache& cache, const ChainSettings& chainSettings, double sampleRate);
+CoefficientSetPtr getLowCutCoefficients(CoefficientCache& cache, const ChainSettings& chainSettings, double sampleRate);
+CoefficientSetPtr getHighCutCoefficients(CoefficientCache& cache, const ChainSettings& chainSettings, double sampleRate);
+
+/**
+ Bytes held by one instance, by subsystem. Heap blocks count at their requested size.
+ The coefficient cache is shared by every instance in the process, so it is not included.
+ */
+struct MemoryFootprint
+{
+    size_t processor = 0;           // the processor object, with its chains, kernel state and snapshot bank
+    size_t peakDynamics = 0;        // detection buffer
+    size_t analyzerCapture = 0;     // tap buffer, plus the capture FIFOs while an editor is open
+    size_t analyzerPipeline = 0;    // editor: FFTs, decimated low band and traces
+    size_t displayLayers = 0;       // editor: cached images and the waterfall
+    size_t spectrumPublishing = 0;  // output capture FIFOs and FFT while some editor shows the spectrum overlay
+    
+    size_t getTotal() const { return processor + peakDynamics + analyzerCapture + analyzerPipeline + displayLayers + spectrumPublishing; }
+    
+    // What an instance may hold without an editor, with blocks up to 8192 samples
+    static constexpr size_t CoreBudget = 192 * 1024;
+    // What the analyzer capture may add at up to 192 kHz and 8192 samples, pre/post taps included
+    static constexpr size_t AnalyzerCaptureBudget = 1024 * 1024;
+};
+
 // Main processor class for the EQ plugin
 class ColinasEQAudioProcessor  : public juce::AudioProcessor
 #if JucePlugin_Enable_ARA
@@ -245,6 +526,9 @@ public:
     // Preparation and resource management functions
     void prepareToPlay(double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    
+    // Starts or stops the offline render workers, for hosts that switch without preparing again
+    void setNonRealtime(bool isNonRealtime) noexcept override;
 
     // Channel layout and processing
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -277,23 +561,180 @@ public:
     // Parameter layout and management
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     juce::AudioProcessorValueTreeState apvts { *this, nullptr, "Parameters", createParameterLayout() };
+    ParameterBindings parameterBindings;
 
     using BlockType = juce::AudioBuffer<float>;
-    SingleChannelSampleFifo<BlockType> leftChannelFifo { Channel::Left };
-    SingleChannelSampleFifo<BlockType> rightChannelFifo { Channel::Right};
     
+    // Analyzer capture buffers. These only exist while an editor is open
+    struct AnalyzerFifos
+    {
+        SingleChannelSampleFifo<BlockType> leftChannelFifo { Channel::Left };
+        SingleChannelSampleFifo<BlockType> rightChannelFifo { Channel::Right};
+        
+        // Mid signal before and after the EQ, captured in place of left and right while the pre-EQ taps are on.
+        // They read channel 0 and 1 of the processor's tap buffer
+        SingleChannelSampleFifo<BlockType> preEqFifo { Channel::Right };
+        SingleChannelSampleFifo<BlockType> postEqFifo { Channel::Left };
+        
+        /** Sizes every FIFO for the block size and sample rate. The pre/post pair is only allocated while the taps are on */
+        void prepare(int blockSize, double sampleRate, bool withPreEqTaps);
+        void preparePreEqTaps(int blockSize, double sampleRate, bool enabled);
+        size_t getNumBytes() const;
+    };
+    
+    /** Creates the analyzer FIFOs on first use. Call from the message thread, once per editor */
+    AnalyzerFifos& acquireAnalyzerFifos();
+    /** Releases the analyzer FIFOs once the last editor using them has gone */
+    void releaseAnalyzerFifos();
+    /** Switches the analyzer capture from output left/right to pre/post EQ mid while any editor asks for it.
+        Counted, like the analyzer FIFOs: every call with true needs a matching call with false. Message thread only */
+    void setPreEqAnalyzerEnabled(bool enabled);
+    
+    /** Output capture for the spectrum publisher, separate from the editors' so neither takes the other's buffers.
+        Only one publisher exists per instance. Message thread only */
+    AnalyzerFifos& acquireSpectrumFifos();
+    void releaseSpectrumFifos();
+    
+    /** Where this instance's output spectrum is published in the SpectrumRegistry, or -1 if every slot was taken */
+    int getSpectrumSlot() const;
+    
+    SnapshotBank snapshotBank;
+    
+    /** The settings the chains currently follow, i.e. the morphed snapshots while morphing is on. Message thread only */
+    ChainSettings getEffectiveChainSettings();
+    
+    /** Writes the band parameters, bypass states included, as one gesture each. The design mode is left alone. Message thread only */
+    void setChainSettings(const ChainSettings& chainSettings);
+    
+    /** Fills in the processor side of the footprint. Not for the audio thread */
+    MemoryFootprint getMemoryFootprint();
+    
+    /** How many times a channel's filter state went NaN or infinite and had to be reset */
+    int getFilterResetCount() const { return filterResetCount.load(std::memory_order_relaxed); }
+    
+    /** The meters only run while some editor shows them. Counted, like the analyzer FIFOs. Message thread only */
+    void setMeteringEnabled(bool enabled);
+    LevelMeter& getInputMeter() { return inputMeter; }
+    LevelMeter& getOutputMeter() { return outputMeter; }
+    
+    /** Smoothed time both meters take, per sample of a block */
+    float getMeteringCostNanosecondsPerSample() const { return meteringCost.load(std::memory_order_relaxed); }
     
 private:
-    // Mono filter chains for left and right channels
+    // Mono filter chains for left and right channels. They hold the coefficients, the chain kernel runs them
     MonoChain leftChain, rightChain;
+    ChainKernels::State leftChainState, rightChainState;
+    ChainKernels::Kernel chainKernel = nullptr;
+    
+    // Picks the kernel matching the slopes and bypass states. Call after every coefficient update
+    void selectChainKernel(const ChainSettings& chainSettings);
+
+    juce::SharedResourcePointer<CoefficientCache> coefficientCache;
 
-    // Functions to update the filters in the chain
+    // Functions to update the filters in the chain from the shared cache. Morphing designs in place instead
     void updatePeakFilter(const ChainSettings& chainSettings);
     void updateLowCutFilters(const ChainSettings& chainSettings);
     void updateHighCutFilters(const ChainSettings& chainSettings);
     void updateFilters();
+    void updateFilters(const ChainSettings& chainSettings);
+    
+    // What each band's coefficients were last designed from, so blocks that change nothing never touch the shared cache.
+    // A band is marked stale whenever its coefficients are written some other way
+    ChainSettings appliedSettings;
+    bool lowCutStale = true, peakStale = true, highCutStale = true;
+    void markFiltersStale() { lowCutStale = peakStale = highCutStale = true; }
+    
+    void processChains(juce::dsp::AudioBlock<float>& block, bool inParallel = false);
+    
+    // Offline renders can opt in to running the channels on worker threads. Sub-blocks are too short to be worth it
+    static constexpr int MinParallelBlockSize = 2048;
+    ChannelWorkers channelWorkers;
+    bool shouldProcessInParallel(int numSamples) const;
+    void updateChannelWorkers(bool isNonRealtime);
+    
+    // Once per block: resets filter sections whose state is no longer finite and silences that channel's block.
+    // The dynamic peak's detector is reset the same way
+    void recoverNonFiniteStates(juce::dsp::AudioBlock<float>& block);
+    std::atomic<int> filterResetCount { 0 };
+    
+    // Morphing and the dynamic peak band update coefficients every SubBlockSize samples
+    static constexpr int SubBlockSize = 32;
+    void processInSubBlocks(juce::dsp::AudioBlock<float>& block,
+                            const juce::AudioBuffer<float>& detectionBuffer,
+                            bool morphing,
+                            const PeakDynamicsSettings& dynamicsSettings);
+    
+    // Snapshot morphing. Switching it on or off ramps morphEngagement, which blends from or back to the live settings
+    bool isMorphActive();
+    void applyMorphedSettings(const ChainSettings& chainSettings);
+    
+    ChainSettings morphA, morphB, lastMorphedSettings;
+    bool morphPairStored = false;
+    bool morphNeedsFullUpdate = true;
+    int morphBankVersion = -1;
+    float lastMorphAmount = -1.f, lastMorphEngagement = -1.f;
+    juce::SmoothedValue<float> morphAmount, morphEngagement;
+    
+    // Cut slopes and bypass states can't be interpolated. When morphing changes which sections run,
+    // the outgoing chain is frozen here and crossfaded into the new one over SlopeCrossfadeSeconds
+    struct SlopeCrossfade
+    {
+        std::array<BilinearDesign::Biquad, ChainKernels::NumSections> sections {};
+        ChainKernels::State leftState, rightState;
+        ChainKernels::Kernel kernel = nullptr;
+        std::array<std::array<float, SubBlockSize>, 2> buffer {};
+        int length = 0, remaining = 0;
+    };
+    
+    static constexpr double SlopeCrossfadeSeconds = 0.02;
+    SlopeCrossfade slopeCrossfade;
+    // Nothing has run since prepareToPlay, so a design change has nothing to crossfade from
+    bool chainsHaveRun = false;
+    void startSlopeCrossfade();
+    void mixSlopeCrossfade(juce::dsp::AudioBlock<float>& subBlock);
+    
+    PeakDynamics peakDynamics;
+    bool peakDynamicsWasEnabled = false;
+    
+    // Loudness compensation, evaluated from the sections the chains already hold. It follows the static
+    // response: the dynamic peak gain is not compensated, which would undo it
+    AutoGain autoGain;
+    ChainSettings autoGainSettings;
+    bool autoGainNeedsUpdate = true;
+    void updateAutoGain(const ChainSettings& chainSettings, bool peakIsDynamic);
+    
+    // Fast path for the binary state written by getStateInformation. Returns false for older ValueTree states
+    bool readBinaryState(const void* data, int sizeInBytes);
+    std::unordered_map<int, int> parameterIndexByIdHash;
+    
+    // Guards analyzerFifos. The audio thread only ever tries the lock and skips capture if it is busy
+    juce::SpinLock analyzerLock;
+    std::unique_ptr<AnalyzerFifos> analyzerFifos, spectrumFifos;
+    int numAnalyzerUsers = 0;
+    std::atomic<int> maxBlockSize { 0 };
+    
+    /** Allocates FIFOs for the current block size and sample rate outside the lock, then installs them under it */
+    void installAnalyzerFifos(std::unique_ptr<AnalyzerFifos>& target, bool withPreEqTaps);
+    
+    // Input and output metering. meteringWasActive is the audio thread's, so it can reset the meters when they start
+    LevelMeter inputMeter, outputMeter;
+    std::atomic<int> numMeterUsers { 0 };
+    std::atomic<float> meteringCost { 0.f };
+    bool meteringWasActive = false;
+    
+    // The pre-EQ taps. Channel 0 holds the input mid signal, channel 1 the output mid signal
+    juce::AudioBuffer<float> analyzerTapBuffer;
+    std::atomic<bool> preEqTapEnabled { false };
+    int numPreEqUsers = 0;
+    // Some open view still shows left/right while another has the taps on
+    std::atomic<bool> leftRightCaptureWanted { false };
+    
+#if COLINASEQ_ENABLE_TEST_SIGNAL
+    TestSignal testSignal;
+#endif
     
-    juce::dsp::Oscillator<float> osc;
+    // Declared last so its timer stops before anything it uses goes
+    std::unique_ptr<SpectrumPublisher> spectrumPublisher;
 
     // Prevent copying and assigning
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ColinasEQAudioProcessor)
@@ -0,0 +1,883 @@
+#include "ProcessorTests.h"
+
+#if COLINASEQ_ENABLE_TESTS
+
+#include "PluginProcessor.h"
+
+#include <cmath>
+#include <complex>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    /** Runs task(0) to task(numTasks - 1) on the pool and waits for all of them */
+    void parallelFor(juce::ThreadPool& pool, int numTasks, const std::function<void(int)>& task)
+    {
+        std::atomic<int> remaining { numTasks };
+        juce::WaitableEvent done;
+
+        for (int i = 0; i < numTasks; ++i)
+        {
+            pool.addJob([&, i]
+            {
+                task(i);
+
+                if (--remaining == 0)
+                    done.signal();
+
+                return juce::ThreadPoolJob::jobHasFinished;
+            });
+        }
+
+        if (numTasks > 0)
+            done.wait();
+    }
+
+    /** value is in the parameter's own units */
+    void setParameter(ColinasEQAudioProcessor& processor, Params::Index index, float value)
+    {
+        auto* parameter = processor.apvts.getParameter(Params::ids[index]);
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    }
+
+    /** Writes the band parameters and the design mode of a processor */
+    void applySettings(ColinasEQAudioProcessor& processor, const ChainSettings& settings)
+    {
+        processor.setChainSettings(settings);
+        setParameter(processor, Params::FilterDesign, (float) settings.designMode);
+    }
+
+    void prepare(ColinasEQAudioProcessor& processor, double sampleRate, int blockSize)
+    {
+        processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+    }
+
+    /** Runs the buffer through the processor in place, blockSize samples at a time with a shorter last block */
+    void render(ColinasEQAudioProcessor& processor, juce::AudioBuffer<float>& buffer, int blockSize)
+    {
+        juce::MidiBuffer midi;
+
+        for (int start = 0; start < buffer.getNumSamples(); start += blockSize)
+        {
+            auto length = juce::jmin(blockSize, buffer.getNumSamples() - start);
+            juce::AudioBuffer<float> block(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, length);
+
+            processor.processBlock(block, midi);
+        }
+    }
+
+    /** Renders a tenth of a second of silence, so every ramp started by prepareToPlay or the first block has finished */
+    void settle(ColinasEQAudioProcessor& processor, double sampleRate, int blockSize)
+    {
+        juce::AudioBuffer<float> silence(2, juce::roundToInt(sampleRate * 0.1));
+        silence.clear();
+        render(processor, silence, blockSize);
+    }
+}
+
+/**
+ Closed-form magnitudes of the bands, worked out from the analog prototypes without any of the
+ plugin's design code, so an error in a design can't show up on both sides of a comparison.
+ */
+namespace ReferenceResponse
+{
+    constexpr double pi = juce::MathConstants<double>::pi;
+
+    /** |H|^2 of the analog prototypes, at w = frequency / design frequency */
+    double peakPrototype(double w, double gain, double quality)
+    {
+        const auto A = std::sqrt(gain);
+        const auto real = juce::square(1.0 - w * w);
+        return (real + juce::square(w * A / quality)) / (real + juce::square(w / (A * quality)));
+    }
+
+    double lowPassPrototype(double w, double quality)
+    {
+        return 1.0 / (juce::square(1.0 - w * w) + juce::square(w / quality));
+    }
+
+    double highPassPrototype(double w, double quality)
+    {
+        return juce::square(w * w) * lowPassPrototype(w, quality);
+    }
+
+    /** RBJ high shelf, with the shelf gain in A = sqrt(gain) as in the Cookbook */
+    double highShelfPrototype(double w, double gain, double quality)
+    {
+        const auto A = std::sqrt(gain);
+        const auto k = std::sqrt(A) / quality;
+        return A * A * (juce::square(1.0 - A * w * w) + juce::square(k * w))
+                     / (juce::square(A - w * w) + juce::square(k * w));
+    }
+
+    /** Q of each second order section of an order N Butterworth */
+    double getButterworthQuality(int section, int order)
+    {
+        return 1.0 / (2.0 * std::cos((2.0 * section + 1.0) * pi / (2.0 * order)));
+    }
+
+    /** The bilinear transform maps the analog response exactly, along tan(omega / 2) */
+    double getWarpedRatio(double frequency, double designFrequency, double sampleRate)
+    {
+        return std::tan(pi * frequency / sampleRate) / std::tan(pi * designFrequency / sampleRate);
+    }
+
+    /**
+     Vicanek's matched designs, "Matched Second Order Digital Filters" (2016). The poles are the impulse
+     invariant ones of s^2 + s / Q + 1, and the numerator follows from matching the analog magnitude at DC,
+     at Nyquist and, for the peak, at the centre. Everything here is on the unit circle at omega.
+     */
+    double getPoleMagnitudeSquared(double omega0, double quality, double omega)
+    {
+        const auto zeta = 0.5 / quality;
+        const auto root = std::sqrt(std::complex<double>(zeta * zeta - 1.0));
+        const auto z1 = std::exp(omega0 * (-zeta + root));
+        const auto z2 = std::exp(omega0 * (-zeta - root));
+        const auto delay = std::polar(1.0, -omega);
+
+        return std::norm((1.0 - z1 * delay) * (1.0 - z2 * delay));
+    }
+
+    /** The basis |b0 + b1 z^-1 + b2 z^-2|^2 = B0 phi0 + B1 phi1 + B2 phi2 is written in */
+    struct Phi
+    {
+        double phi0, phi1, phi2;
+    };
+
+    Phi getPhi(double omega)
+    {
+        const auto s = juce::square(std::sin(omega * 0.5));
+        return { 1.0 - s, s, 4.0 * (1.0 - s) * s };
+    }
+
+    double matchedPeak(double omega0, double gain, double quality, double omega)
+    {
+        /** A cut is the inverse of the boost by the same amount */
+        if (gain < 1.0)
+            return 1.0 / matchedPeak(omega0, 1.0 / gain, quality, omega);
+
+        /** The boost's poles are those of the prototype's denominator, s^2 + s / (Q A) + 1 */
+        const auto poleQuality = quality * std::sqrt(gain);
+        auto denominator = [&](double w) { return getPoleMagnitudeSquared(omega0, poleQuality, w); };
+
+        const auto B0 = denominator(0.0);
+        const auto B1 = peakPrototype(pi / omega0, gain, quality) * denominator(pi);
+        const auto centre = getPhi(omega0);
+        const auto B2 = (gain * gain * denominator(omega0) - B0 * centre.phi0 - B1 * centre.phi1) / centre.phi2;
+
+        const auto phi = getPhi(omega);
+        return std::sqrt((B0 * phi.phi0 + B1 * phi.phi1 + B2 * phi.phi2) / denominator(omega));
+    }
+
+    double matchedLowPass(double omega0, double quality, double omega)
+    {
+        const auto B0 = getPoleMagnitudeSquared(omega0, quality, 0.0);
+        const auto B1 = lowPassPrototype(pi / omega0, quality) * getPoleMagnitudeSquared(omega0, quality, pi);
+        const auto phi = getPhi(omega);
+
+        return std::sqrt((B0 * phi.phi0 + B1 * phi.phi1) / getPoleMagnitudeSquared(omega0, quality, omega));
+    }
+
+    double matchedHighPass(double omega0, double quality, double omega)
+    {
+        /** Both zeros sit at DC, so only the gain at Nyquist is left to match */
+        const auto B = highPassPrototype(pi / omega0, quality) * getPoleMagnitudeSquared(omega0, quality, pi);
+        const auto phi = getPhi(omega);
+
+        return std::sqrt(B * phi.phi1 * phi.phi1 / getPoleMagnitudeSquared(omega0, quality, omega));
+    }
+
+    /** Linear gain of the whole EQ at one frequency */
+    double getMagnitude(const ChainSettings& settings, double sampleRate, double frequency)
+    {
+        const auto lowCutFrequency = (double) clampDesignFrequency(settings.lowCutFreq, sampleRate);
+        const auto peakFrequency = (double) clampDesignFrequency(settings.peakFreq, sampleRate);
+        const auto highCutFrequency = (double) clampDesignFrequency(settings.highCutFreq, sampleRate);
+        const auto peakGain = juce::Decibels::decibelsToGain((double) settings.peakGainDecibels);
+        const auto peakQuality = (double) settings.peakQuality;
+        const auto lowCutOrder = 2 * (settings.lowCutSlope + 1);
+        const auto highCutOrder = 2 * (settings.highCutSlope + 1);
+
+        double magnitude = 1.0;
+
+        if (settings.designMode == Design_Matched)
+        {
+            auto toOmega = [sampleRate](double f) { return 2.0 * pi * f / sampleRate; };
+            const auto omega = toOmega(frequency);
+
+            /** The matched cuts are cascades of matched sections at the Butterworth Qs, not Butterworth responses */
+            if (! settings.lowCutBypassed)
+                for (int i = 0; i < lowCutOrder / 2; ++i)
+                    magnitude *= matchedHighPass(toOmega(lowCutFrequency), getButterworthQuality(i, lowCutOrder), omega);
+
+            if (! settings.peakBypassed)
+                magnitude *= matchedPeak(toOmega(peakFrequency), peakGain, peakQuality, omega);
+
+            if (! settings.highCutBypassed)
+                for (int i = 0; i < highCutOrder / 2; ++i)
+                    magnitude *= matchedLowPass(toOmega(highCutFrequency), getButterworthQuality(i, highCutOrder), omega);
+
+            return magnitude;
+        }
+
+        if (! settings.lowCutBypassed)
+            magnitude /= std::sqrt(1.0 + std::pow(getWarpedRatio(frequency, lowCutFrequency, sampleRate), -2.0 * lowCutOrder));
+
+        if (! settings.peakBypassed)
+            magnitude *= std::sqrt(peakPrototype(getWarpedRatio(frequency, peakFrequency, sampleRate), peakGain, peakQuality));
+
+        if (! settings.highCutBypassed)
+            magnitude /= std::sqrt(1.0 + std::pow(getWarpedRatio(frequency, highCutFrequency, sampleRate), 2.0 * highCutOrder));
+
+        return magnitude;
+    }
+
+    /** AutoGain's definition: the inverse of the K-weighted RMS gain over pink noise, from 20 Hz to 20 kHz */
+    double getAutoGainCompensation(const ChainSettings& settings, double sampleRate)
+    {
+        double power = 0.0, weightSum = 0.0;
+
+        for (int i = 0; i < AutoGain::NumPoints; ++i)
+        {
+            const auto frequency = juce::mapToLog10((double) i / (double) (AutoGain::NumPoints - 1), 20.0, 20000.0);
+
+            if (frequency > sampleRate * 0.45)
+                continue;
+
+            /** BS.1770's pre-filter, a +4 dB shelf at 1.5 kHz and a 38 Hz high-pass, both bilinear */
+            const auto weight = highShelfPrototype(getWarpedRatio(frequency, 1500.0, sampleRate), juce::Decibels::decibelsToGain(4.0), 0.71)
+                              * highPassPrototype(getWarpedRatio(frequency, 38.0, sampleRate), 0.5);
+
+            power += weight * juce::square(getMagnitude(settings, sampleRate, frequency));
+            weightSum += weight;
+        }
+
+        const auto limit = (double) AutoGain::MaxCompensationDecibels;
+        return juce::Decibels::decibelsToGain(juce::jlimit(-limit, limit, -10.0 * std::log10(power / weightSum)));
+    }
+}
+
+/**
+ Renders impulses, sweeps and noise through the processor over a sampled grid of settings,
+ sample rates and block sizes, and compares the measured response with the closed-form one
+ from ReferenceResponse. Besides the static EQ, some cases morph between snapshots, run the
+ peak band dynamic below its threshold, compensate the loudness or render offline on the
+ channel workers, and all of them have to land on the same response. Every case also has to
+ come out the same at every block size, and on both channels. Cases are rendered in parallel
+ on a juce::ThreadPool.
+ */
+struct ProcessorResponseTest : juce::UnitTest
+{
+    ProcessorResponseTest() : juce::UnitTest("Processor response", "ColinasEQ") {}
+
+    static constexpr int NumSettingsPerRate = 12;
+    static constexpr int NumCasesPerFeature = 3;
+    // Largest error of the measured gain, relative to the larger of the expected gain and unity
+    static constexpr double Tolerance = 0.05;
+    // Bins where the reference is below this are left to the float noise floor
+    static constexpr float MinCheckedDecibels = -30.f;
+    // The kernels snap tiny states to zero at the end of every block, so block sizes only agree to within this, relative to the output peak
+    static constexpr float BlockSizeTolerance = 0.01f;
+    // Below this the float kernels' own rounding noise around the low poles outweighs the response
+    static constexpr double MinCheckedFrequency = 100.0;
+    static constexpr int NumCheckedFrequencies = 512;
+    // Largest error of a design against the closed form, in dB. The float coefficients account for most of it
+    static constexpr double DesignTolerance = 0.25;
+
+    enum Signal
+    {
+        Impulse,
+        Sweep,
+        Noise,
+        NumSignals
+    };
+
+    // What a case switches on besides the bands. Each one has to leave the static response as it is,
+    // apart from the loudness compensation's gain
+    enum Feature
+    {
+        Static,
+        Morphing,
+        DynamicPeak,
+        LoudnessCompensation,
+        OfflineRender,
+        NumFeatures
+    };
+
+    struct Case
+    {
+        std::unique_ptr<ColinasEQAudioProcessor> processor;
+        ChainSettings settings;
+        Feature feature = Static;
+        double sampleRate = 48000.0;
+        juce::StringArray failures;
+    };
+
+    void runTest() override
+    {
+        const double sampleRates[] { 44100.0, 48000.0, 96000.0 };
+
+        std::vector<Case> cases;
+        juce::Random random(0x436f6c);
+
+        for (auto sampleRate : sampleRates)
+        {
+            for (int feature = 0; feature < NumFeatures; ++feature)
+            {
+                const auto numCases = feature == Static ? NumSettingsPerRate : NumCasesPerFeature;
+
+                for (int i = 0; i < numCases; ++i)
+                {
+                    /** The parameter tree runs a timer, so processors are only created and destroyed on this thread */
+                    Case c;
+                    c.processor = std::make_unique<ColinasEQAudioProcessor>();
+                    c.feature = static_cast<Feature>(feature);
+                    c.sampleRate = sampleRate;
+                    applySettings(*c.processor, makeRandomSettings(random));
+                    enableFeature(*c.processor, c.feature, random);
+
+                    /** The parameters snap to their intervals, so the reference follows what the processor actually got */
+                    c.settings = c.processor->getEffectiveChainSettings();
+                    cases.push_back(std::move(c));
+                }
+            }
+        }
+
+        beginTest("Rendered response matches the closed-form response at every block size");
+
+        juce::ThreadPool pool(juce::jmax(1, juce::SystemStats::getNumCpus()));
+        parallelFor(pool, (int) cases.size(), [&cases](int i) { runCase(cases[(size_t) i]); });
+
+        /** expect isn't thread safe, so the results are only reported once every case is done */
+        for (const auto& c : cases)
+            expect(c.failures.isEmpty(), c.failures.joinIntoString("\n"));
+
+        beginTest("Cached and in-place designs match the closed form");
+
+        for (const auto& c : cases)
+            checkDesigns(c.settings, c.sampleRate);
+    }
+
+private:
+    static ChainSettings makeRandomSettings(juce::Random& random)
+    {
+        auto logUniform = [&random](float low, float high)
+        {
+            return juce::mapToLog10(random.nextFloat(), low, high);
+        };
+
+        /** Peak frequencies and Qs are kept where the ringing dies out within the render's tail */
+        ChainSettings settings;
+        settings.lowCutFreq = logUniform(20.f, 500.f);
+        settings.highCutFreq = logUniform(2000.f, 20000.f);
+        settings.peakFreq = logUniform(50.f, 18000.f);
+        settings.peakGainDecibels = juce::jmap(random.nextFloat(), -24.f, 24.f);
+        settings.peakQuality = logUniform(0.3f, 5.f);
+        settings.lowCutSlope = static_cast<Slope>(random.nextInt(4));
+        settings.highCutSlope = static_cast<Slope>(random.nextInt(4));
+        settings.lowCutBypassed = random.nextInt(4) == 0;
+        settings.peakBypassed = random.nextInt(4) == 0;
+        settings.highCutBypassed = random.nextInt(4) == 0;
+        settings.designMode = static_cast<DesignMode>(random.nextInt(2));
+        return settings;
+    }
+
+    static void enableFeature(ColinasEQAudioProcessor& processor, Feature feature, juce::Random& random)
+    {
+        switch (feature)
+        {
+            case Morphing:
+                /** The live settings only pick the design mode, the bands come from somewhere between the snapshots */
+                processor.snapshotBank.store(SnapshotBank::A, makeRandomSettings(random));
+                processor.snapshotBank.store(SnapshotBank::B, makeRandomSettings(random));
+                setParameter(processor, Params::Morph, random.nextFloat());
+                setParameter(processor, Params::MorphEnabled, 1.f);
+                break;
+
+            case DynamicPeak:
+                /** None of the signals gets the detector up to 0 dB, so the band has to sit at its static gain */
+                setParameter(processor, Params::PeakDynamic, 1.f);
+                setParameter(processor, Params::PeakThreshold, 0.f);
+                setParameter(processor, Params::PeakRatio, 4.f);
+                break;
+
+            case LoudnessCompensation:
+                setParameter(processor, Params::AutoGain, 1.f);
+                break;
+
+            case OfflineRender:
+                setParameter(processor, Params::ParallelRender, 1.f);
+                processor.setNonRealtime(true);
+                break;
+
+            case Static:
+            case NumFeatures:
+                break;
+        }
+    }
+
+    static juce::String describe(const ChainSettings& s, double sampleRate, Feature feature = Static)
+    {
+        const char* featureNames[] { "static", "morphing", "dynamic peak", "auto gain", "offline" };
+
+        juce::String text;
+        text << sampleRate << " Hz, " << featureNames[feature] << ", " << (s.designMode == Design_Matched ? "matched" : "bilinear")
+             << ", low cut " << s.lowCutFreq << " Hz slope " << (int) s.lowCutSlope << (s.lowCutBypassed ? " (bypassed)" : "")
+             << ", peak " << s.peakFreq << " Hz " << s.peakGainDecibels << " dB Q " << s.peakQuality << (s.peakBypassed ? " (bypassed)" : "")
+             << ", high cut " << s.highCutFreq << " Hz slope " << (int) s.highCutSlope << (s.highCutBypassed ? " (bypassed)" : "");
+        return text;
+    }
+
+    /** The signal in the first part of the buffer, silence after it so the response can ring out */
+    static void makeSignal(Signal signal, juce::AudioBuffer<float>& buffer, double sampleRate)
+    {
+        buffer.clear();
+
+        auto* samples = buffer.getWritePointer(0);
+        const auto signalLength = juce::roundToInt(sampleRate * 0.25);
+
+        switch (signal)
+        {
+            case Impulse:
+                samples[0] = 1.f;
+                break;
+
+            case Sweep:
+            {
+                /** Exponential sine sweep across the checked range */
+                const auto startFrequency = 10.0, endFrequency = sampleRate * 0.45;
+                const auto duration = signalLength / sampleRate;
+                const auto rate = std::log(endFrequency / startFrequency);
+
+                for (int i = 0; i < signalLength; ++i)
+                {
+                    auto t = i / sampleRate;
+                    auto phase = juce::MathConstants<double>::twoPi * startFrequency * duration / rate
+                               * (std::exp(t / duration * rate) - 1.0);
+                    samples[i] = (float) (0.5 * std::sin(phase));
+                }
+                break;
+            }
+
+            case Noise:
+            {
+                juce::Random random(signalLength);
+
+                for (int i = 0; i < signalLength; ++i)
+                    samples[i] = random.nextFloat() - 0.5f;
+                break;
+            }
+
+            case NumSignals:
+                break;
+        }
+
+        for (int ch = 1; ch < buffer.getNumChannels(); ++ch)
+            buffer.copyFrom(ch, 0, buffer, 0, 0, buffer.getNumSamples());
+    }
+
+    /** Lowest frequency checked against the closed form. Just above a low cut the float coefficients are too coarse */
+    static double getFirstCheckedFrequency(const ChainSettings& settings)
+    {
+        return juce::jmax(MinCheckedFrequency, settings.lowCutBypassed ? 0.0 : 2.0 * settings.lowCutFreq);
+    }
+
+    /** The chain as the processor builds it from the coefficient cache */
+    static void designCachedChain(MonoChain& chain, const ChainSettings& settings, double sampleRate)
+    {
+        chain.setBypassed<ChainPositions::LowCut>(settings.lowCutBypassed);
+        chain.setBypassed<ChainPositions::Peak>(settings.peakBypassed);
+        chain.setBypassed<ChainPositions::HighCut>(settings.highCutBypassed);
+
+        updateCoefficients(chain.get<ChainPositions::Peak>().coefficients, makePeakFilter(settings, sampleRate));
+        updateCutFilter(chain.get<ChainPositions::LowCut>(), makeLowCutFilter(settings, sampleRate), settings.lowCutSlope);
+        updateCutFilter(chain.get<ChainPositions::HighCut>(), makeHighCutFilter(settings, sampleRate), settings.highCutSlope);
+    }
+
+    /**
+     Worst error of |Y / X| against the closed form times outputGain, at log-spaced frequencies between
+     firstFrequency and the highest design frequency. The render is long enough for the whole response
+     to fit, so the ratio of the spectra is the response itself wherever the input has energy
+     */
+    static void checkResponse(const juce::AudioBuffer<float>& input, const juce::AudioBuffer<float>& output,
+                              const ChainSettings& settings, double outputGain, double sampleRate, double firstFrequency,
+                              int fftOrder, const juce::String& label, juce::StringArray& failures)
+    {
+        juce::dsp::FFT fft(fftOrder);
+        const auto size = fft.getSize();
+
+        std::vector<float> x((size_t) size * 2), y((size_t) size * 2);
+        std::copy(input.getReadPointer(0), input.getReadPointer(0) + size, x.begin());
+        std::copy(output.getReadPointer(0), output.getReadPointer(0) + size, y.begin());
+
+        fft.performFrequencyOnlyForwardTransform(x.data(), true);
+        fft.performFrequencyOnlyForwardTransform(y.data(), true);
+
+        const auto binWidth = sampleRate / size;
+        const auto lastFrequency = sampleRate * MaxDesignFrequencyRatio;
+
+        double meanPower = 0.0;
+        for (int bin = 1; bin < size / 2; ++bin)
+            meanPower += (double) x[(size_t) bin] * x[(size_t) bin];
+        meanPower /= size / 2 - 1;
+
+        double worst = 0.0, worstFrequency = 0.0;
+
+        for (int i = 0; i < NumCheckedFrequencies; ++i)
+        {
+            auto bin = juce::roundToInt(juce::mapToLog10((double) i / (NumCheckedFrequencies - 1), firstFrequency, lastFrequency) / binWidth);
+            auto frequency = bin * binWidth;
+
+            /** Noise and the ends of the sweep leave some bins with too little energy to measure */
+            if ((double) x[(size_t) bin] * x[(size_t) bin] < 0.01 * meanPower)
+                continue;
+
+            auto response = ReferenceResponse::getMagnitude(settings, sampleRate, frequency);
+
+            if (juce::Decibels::gainToDecibels(response, -200.0) < MinCheckedDecibels)
+                continue;
+
+            auto expected = response * outputGain;
+
+            /** Relative to unity below it, so deep cuts aren't held to more than the float noise floor */
+            auto measured = (double) y[(size_t) bin] / x[(size_t) bin];
+            auto error = std::abs(measured - expected) / juce::jmax(expected, 1.0);
+
+            if (error > worst)
+            {
+                worst = error;
+                worstFrequency = frequency;
+            }
+        }
+
+        if (worst > Tolerance)
+            failures.add(label + ": gain off by " + juce::String(worst * 100.0, 2) + "% at " + juce::String(worstFrequency, 1) + " Hz");
+    }
+
+    static void runCase(Case& c)
+    {
+        const int blockSizes[] { 32, 500, 4096 };
+        const char* signalNames[] { "impulse", "sweep", "noise" };
+
+        /** At least 2.5 s, so the slowest ringing sampled dies out before the end */
+        const auto fftOrder = juce::roundToInt(std::ceil(std::log2(c.sampleRate * 2.5)));
+        const auto length = 1 << fftOrder;
+
+        auto& processor = *c.processor;
+        const auto description = describe(c.settings, c.sampleRate, c.feature);
+        const auto firstFrequency = getFirstCheckedFrequency(c.settings);
+
+        /** Only the loudness compensation changes the level, by the same gain at every frequency */
+        const auto outputGain = c.feature == LoudnessCompensation ? ReferenceResponse::getAutoGainCompensation(c.settings, c.sampleRate) : 1.0;
+
+        juce::AudioBuffer<float> input(2, length), output(2, length), firstOutput(2, length);
+
+        /** prepareToPlay clears the filter state, so every render starts from silence */
+        auto renderFromSilence = [&](juce::AudioBuffer<float>& buffer, int blockSize)
+        {
+            prepare(processor, c.sampleRate, blockSize);
+            settle(processor, c.sampleRate, blockSize);
+            buffer.makeCopyOf(input, true);
+            render(processor, buffer, blockSize);
+        };
+
+        for (int signal = 0; signal < NumSignals; ++signal)
+        {
+            makeSignal(static_cast<Signal>(signal), input, c.sampleRate);
+
+            for (size_t b = 0; b < std::size(blockSizes); ++b)
+            {
+                juce::String label;
+                label << description << ", " << signalNames[signal] << ", block size " << blockSizes[b];
+
+                renderFromSilence(output, blockSizes[b]);
+
+                checkResponse(input, output, c.settings, outputGain, c.sampleRate, firstFrequency, fftOrder, label, c.failures);
+
+                if (getMaxDifference(output, 0, output, 1) > 0.f)
+                    c.failures.add(label + ": the channels differ");
+
+                if (b == 0)
+                    firstOutput.makeCopyOf(output, true);
+                else if (getMaxDifference(output, 0, firstOutput, 0) > BlockSizeTolerance * juce::jmax(firstOutput.getMagnitude(0, 0, length), 1.0e-3f))
+                    c.failures.add(label + ": differs from block size " + juce::String(blockSizes[0]));
+
+                /** The largest block size is past MinParallelBlockSize, so its channels ran on the workers. The realtime path has to agree bit for bit */
+                if (c.feature == OfflineRender && b == std::size(blockSizes) - 1)
+                {
+                    juce::AudioBuffer<float> realtimeOutput(2, length);
+
+                    processor.setNonRealtime(false);
+                    renderFromSilence(realtimeOutput, blockSizes[b]);
+                    processor.setNonRealtime(true);
+
+                    if (getMaxDifference(output, 0, realtimeOutput, 0) > 0.f || getMaxDifference(output, 1, realtimeOutput, 1) > 0.f)
+                        c.failures.add(label + ": differs from the realtime render");
+                }
+            }
+        }
+    }
+
+    static float getMaxDifference(const juce::AudioBuffer<float>& a, int channelA, const juce::AudioBuffer<float>& b, int channelB)
+    {
+        auto* x = a.getReadPointer(channelA);
+        auto* y = b.getReadPointer(channelB);
+        float difference = 0.f;
+
+        for (int i = 0; i < a.getNumSamples(); ++i)
+            difference = juce::jmax(difference, std::abs(x[i] - y[i]));
+
+        return difference;
+    }
+
+    /**
+     Both design paths against the closed form, and against each other. The morph path designs in place,
+     and has to land on the same response as the cached designs down to 20 Hz
+     */
+    void checkDesigns(const ChainSettings& settings, double sampleRate)
+    {
+        MonoChain cached, inPlace;
+        designCachedChain(cached, settings, sampleRate);
+
+        makeSecondOrderSections(inPlace);
+        designLowCutInPlace(inPlace, settings, sampleRate);
+        designPeakInPlace(inPlace, settings, sampleRate);
+        designHighCutInPlace(inPlace, settings, sampleRate);
+
+        const auto firstFrequency = getFirstCheckedFrequency(settings);
+        const auto lastFrequency = sampleRate * MaxDesignFrequencyRatio;
+        double worstCached = 0.0, worstInPlace = 0.0, worstDifference = 0.0;
+
+        for (int i = 0; i < 128; ++i)
+        {
+            auto frequency = juce::mapToLog10(i / 127.0, firstFrequency, lastFrequency);
+            auto expected = juce::Decibels::gainToDecibels(ReferenceResponse::getMagnitude(settings, sampleRate, frequency), -200.0);
+
+            if (expected < MinCheckedDecibels)
+                continue;
+
+            auto cachedDecibels = juce::Decibels::gainToDecibels(getChainMagnitudeForFrequency(cached, frequency, sampleRate), -200.0);
+            auto inPlaceDecibels = juce::Decibels::gainToDecibels(getChainMagnitudeForFrequency(inPlace, frequency, sampleRate), -200.0);
+
+            worstCached = juce::jmax(worstCached, std::abs(cachedDecibels - expected));
+            worstInPlace = juce::jmax(worstInPlace, std::abs(inPlaceDecibels - expected));
+        }
+
+        for (int i = 0; i < 128; ++i)
+        {
+            auto frequency = juce::mapToLog10(i / 127.0, 20.0, lastFrequency);
+            auto cachedDecibels = juce::Decibels::gainToDecibels(getChainMagnitudeForFrequency(cached, frequency, sampleRate), -200.0);
+            auto inPlaceDecibels = juce::Decibels::gainToDecibels(getChainMagnitudeForFrequency(inPlace, frequency, sampleRate), -200.0);
+
+            if (cachedDecibels >= MinCheckedDecibels)
+                worstDifference = juce::jmax(worstDifference, std::abs(inPlaceDecibels - cachedDecibels));
+        }
+
+        const auto description = describe(settings, sampleRate);
+        expectLessOrEqual(worstCached, DesignTolerance, description + ", cached against the closed form");
+        expectLessOrEqual(worstInPlace, DesignTolerance, description + ", in place against the closed form");
+        expectLessOrEqual(worstDifference, 0.01, description + ", in place against cached");
+    }
+};
+
+static ProcessorResponseTest processorResponseTest;
+
+/**
+ Plays sines at the centre of the dynamic peak band, above and below its threshold, and checks that
+ the output settles where the static curve puts it: the band's gain less the compressor's reduction
+ above the threshold, the band's own gain below it. At the centre the detector's band-pass is unity
+ and either design is exactly the band's gain, so the expected levels are closed form.
+ */
+struct PeakDynamicsTest : juce::UnitTest
+{
+    PeakDynamicsTest() : juce::UnitTest("Peak dynamics", "ColinasEQ") {}
+
+    static constexpr double SampleRate = 48000.0;
+    // Off any subharmonic of the sample rate, so the sub-blocks don't keep sampling the sine at the same phases
+    static constexpr float Frequency = 3100.f;
+    static constexpr float GainDecibels = 6.f, ThresholdDecibels = -30.f, Ratio = 4.f;
+    // The detector takes the largest sample of each sub-block, which can miss the sine's peak by a little
+    static constexpr float Tolerance = 0.5f;
+
+    void runTest() override
+    {
+        beginTest("A sine at the band's centre settles on the static curve");
+
+        for (auto designMode : { Design_Bilinear, Design_Matched })
+            for (auto amplitude : { 0.25f, 0.01f })
+                checkSteadyState(designMode, amplitude);
+    }
+
+private:
+    void checkSteadyState(DesignMode designMode, float amplitude)
+    {
+        ChainSettings settings;
+        settings.lowCutFreq = 20.f;
+        settings.highCutFreq = 20000.f;
+        settings.peakFreq = Frequency;
+        settings.peakGainDecibels = GainDecibels;
+        settings.peakQuality = 1.f;
+        settings.lowCutBypassed = true;
+        settings.highCutBypassed = true;
+        settings.designMode = designMode;
+
+        ColinasEQAudioProcessor processor;
+        applySettings(processor, settings);
+        setParameter(processor, Params::PeakDynamic, 1.f);
+        setParameter(processor, Params::PeakThreshold, ThresholdDecibels);
+        setParameter(processor, Params::PeakRatio, Ratio);
+        setParameter(processor, Params::PeakAttack, 1.f);
+        prepare(processor, SampleRate, 512);
+
+        /** A second is plenty for the release, and the last tenth of it holds a whole number of periods */
+        juce::AudioBuffer<float> buffer(2, (int) SampleRate);
+
+        for (int i = 0; i < buffer.getNumSamples(); ++i)
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                buffer.setSample(ch, i, amplitude * (float) std::sin(juce::MathConstants<double>::twoPi * Frequency * i / SampleRate));
+
+        render(processor, buffer, 512);
+
+        const auto measuredLength = juce::roundToInt(SampleRate * 0.1);
+        const auto measured = buffer.getRMSLevel(0, buffer.getNumSamples() - measuredLength, measuredLength) * juce::MathConstants<float>::sqrt2;
+
+        const auto over = juce::jmax(0.f, juce::Decibels::gainToDecibels(amplitude) - ThresholdDecibels);
+        const auto expectedDecibels = GainDecibels - over * (1.f - 1.f / Ratio);
+
+        juce::String label;
+        label << (designMode == Design_Matched ? "matched" : "bilinear") << ", input at " << juce::Decibels::gainToDecibels(amplitude) << " dB";
+
+        expectWithinAbsoluteError(juce::Decibels::gainToDecibels(measured / amplitude), expectedDecibels, Tolerance, label);
+    }
+};
+
+static PeakDynamicsTest peakDynamicsTest;
+
+/**
+ Feeds a single NaN into the dynamic peak band and checks that the watchdog resets the chains
+ and the detector, so the block after it comes out finite and not silenced.
+ */
+struct NonFiniteRecoveryTest : juce::UnitTest
+{
+    NonFiniteRecoveryTest() : juce::UnitTest("Non-finite recovery", "ColinasEQ") {}
+
+    void runTest() override
+    {
+        constexpr double sampleRate = 48000.0;
+        constexpr int blockSize = 512;
+
+        beginTest("One NaN sample doesn't poison the dynamic peak band");
+
+        ColinasEQAudioProcessor processor;
+        setParameter(processor, Params::PeakFreq, 1000.f);
+        setParameter(processor, Params::PeakGain, 6.f);
+        setParameter(processor, Params::PeakDynamic, 1.f);
+        setParameter(processor, Params::PeakThreshold, -40.f);
+        setParameter(processor, Params::PeakRatio, 4.f);
+        prepare(processor, sampleRate, blockSize);
+
+        juce::AudioBuffer<float> buffer(2, blockSize);
+        juce::MidiBuffer midi;
+        double phase = 0.0;
+
+        auto fillSine = [&]
+        {
+            for (int i = 0; i < blockSize; ++i, phase += juce::MathConstants<double>::twoPi * 1000.0 / sampleRate)
+                for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                    buffer.setSample(ch, i, (float) (0.5 * std::sin(phase)));
+        };
+
+        fillSine();
+        processor.processBlock(buffer, midi);
+
+        fillSine();
+        buffer.setSample(0, 100, std::numeric_limits<float>::quiet_NaN());
+        processor.processBlock(buffer, midi);
+
+        expectGreaterThan(processor.getFilterResetCount(), 0, "the watchdog saw the NaN");
+
+        fillSine();
+        processor.processBlock(buffer, midi);
+
+        bool allFinite = true;
+
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+            for (int i = 0; i < blockSize; ++i)
+                allFinite = allFinite && std::isfinite(buffer.getSample(ch, i));
+
+        expect(allFinite, "the block after the NaN is finite");
+        expectGreaterThan(buffer.getMagnitude(0, blockSize), 0.1f, "the block after the NaN isn't silenced");
+
+        auto resetsAfterRecovery = processor.getFilterResetCount();
+        fillSine();
+        processor.processBlock(buffer, midi);
+        expectEquals(processor.getFilterResetCount(), resetsAfterRecovery, "nothing is reset once recovered");
+    }
+};
+
+static NonFiniteRecoveryTest nonFiniteRecoveryTest;
+
+/**
+ Prepares instances across sample rates and block sizes and holds them to the budgets stated
+ in MemoryFootprint: the core without an editor, then the analyzer capture with both taps on.
+ Acquiring the analyzer FIFOs is message thread only, so this test has to run on it.
+ */
+struct MemoryBudgetTest : juce::UnitTest
+{
+    MemoryBudgetTest() : juce::UnitTest("Memory budget", "ColinasEQ") {}
+
+    void runTest() override
+    {
+        const double sampleRates[] { 44100.0, 48000.0, 96000.0, 192000.0 };
+        const int blockSizes[] { 32, 64, 512, 1024, 4096, 8192 };
+
+        beginTest("Footprint stays within CoreBudget and AnalyzerCaptureBudget");
+
+        for (auto sampleRate : sampleRates)
+        {
+            for (auto blockSize : blockSizes)
+            {
+                juce::String label;
+                label << sampleRate << " Hz, block size " << blockSize;
+
+                ColinasEQAudioProcessor processor;
+                prepare(processor, sampleRate, blockSize);
+
+                auto footprint = processor.getMemoryFootprint();
+                expectLessOrEqual(footprint.processor + footprint.peakDynamics, MemoryFootprint::CoreBudget, label + ", core");
+
+                /** What an open editor with the pre-EQ trace on adds, whichever order it happens in */
+                processor.acquireAnalyzerFifos();
+                processor.setPreEqAnalyzerEnabled(true);
+                prepare(processor, sampleRate, blockSize);
+
+                footprint = processor.getMemoryFootprint();
+                expectLessOrEqual(footprint.analyzerCapture, MemoryFootprint::AnalyzerCaptureBudget, label + ", analyzer capture");
+
+                processor.setPreEqAnalyzerEnabled(false);
+                processor.releaseAnalyzerFifos();
+            }
+        }
+    }
+};
+
+static MemoryBudgetTest memoryBudgetTest;
+
+int runColinasEQTests()
+{
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+    runner.runTestsInCategory("ColinasEQ");
+
+    int failures = 0;
+
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        failures += runner.getResult(i)->failures;
+
+    return failures;
+}
+
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Set to 1 in the project's preprocessor definitions to build the juce::UnitTest suite in ProcessorTests.cpp
+#ifndef COLINASEQ_ENABLE_TESTS
+ #define COLINASEQ_ENABLE_TESTS 0
+#endif
+
+#if COLINASEQ_ENABLE_TESTS
+/**
+ Runs every test in the "ColinasEQ" category and returns the number of failed checks.
+ Needs no window or audio device, so a small console app or CI host can call it, from the
+ message thread with a juce::ScopedJuceInitialiser_GUI in scope: the memory budget test
+ acquires the analyzer FIFOs, which is message thread only.
+ */
+int runColinasEQTests();
+#endif
@@ -0,0 +1,138 @@
+#include "SpectrumPublisher.h"
+
+SpectrumPublisher::Analysis::Analysis()
+{
+    fftDataGenerator.changeOrder(FFTOrder::order8192);
+    stereoBuffer.setSize(2, fftDataGenerator.getFFTSize());
+    levels.fill(-48.f);
+}
+
+SpectrumPublisher::SpectrumPublisher(ColinasEQAudioProcessor& p) : processor(p)
+{
+    slot = registry->claimSlot();
+
+    /** With every slot taken this instance simply stays off the overlay */
+    if (slot >= 0)
+        startTimerHz(IdleRateHz);
+}
+
+SpectrumPublisher::~SpectrumPublisher()
+{
+    stopTimer();
+    stop();
+
+    if (slot >= 0)
+        registry->releaseSlot(slot);
+}
+
+size_t SpectrumPublisher::getNumBytes() const
+{
+    return numBytes.load(std::memory_order_relaxed);
+}
+
+void SpectrumPublisher::timerCallback()
+{
+    /** Costs nothing beyond this check unless some editor has the overlay on */
+    if (! registry->hasSubscribers())
+    {
+        if (fifos != nullptr)
+        {
+            stop();
+            startTimerHz(IdleRateHz);
+        }
+
+        return;
+    }
+
+    if (fifos == nullptr)
+    {
+        start();
+        startTimerHz(PublishRateHz);
+        return;
+    }
+
+    auto& stereoBuffer = analysis->stereoBuffer;
+    auto& leftFifo = fifos->leftChannelFifo;
+    auto& rightFifo = fifos->rightChannelFifo;
+    bool newSamples = false;
+
+    /** Both FIFOs are filled by the same processBlock calls, so their buffers arrive in pairs */
+    while (leftFifo.getNumCompleteBuffersAvailable() > 0
+           && rightFifo.getNumCompleteBuffersAvailable() > 0)
+    {
+        if (! leftFifo.getAudioBuffer(analysis->leftBuffer) || ! rightFifo.getAudioBuffer(analysis->rightBuffer))
+            break;
+
+        /** Blocks longer than the FFT only contribute their newest samples */
+        auto numSamples = analysis->leftBuffer.getNumSamples();
+        auto size = juce::jmin(numSamples, stereoBuffer.getNumSamples());
+        auto keep = stereoBuffer.getNumSamples() - size;
+
+        juce::FloatVectorOperations::copy(stereoBuffer.getWritePointer(0, 0), stereoBuffer.getReadPointer(0, size), keep);
+        juce::FloatVectorOperations::copy(stereoBuffer.getWritePointer(1, 0), stereoBuffer.getReadPointer(1, size), keep);
+
+        juce::FloatVectorOperations::copy(stereoBuffer.getWritePointer(0, keep), analysis->leftBuffer.getReadPointer(0, numSamples - size), size);
+        juce::FloatVectorOperations::copy(stereoBuffer.getWritePointer(1, keep), analysis->rightBuffer.getReadPointer(0, numSamples - size), size);
+
+        newSamples = true;
+    }
+
+    /** A stopped host sends nothing, and readers drop the slot once it goes stale */
+    if (newSamples)
+        publish(processor.getSampleRate());
+}
+
+void SpectrumPublisher::start()
+{
+    analysis = std::make_unique<Analysis>();
+    fifos = &processor.acquireSpectrumFifos();
+
+    numBytes = sizeof(Analysis) + analysis->fftDataGenerator.getNumBytes()
+             + (size_t) (analysis->stereoBuffer.getNumChannels() * analysis->stereoBuffer.getNumSamples()) * sizeof(float);
+}
+
+void SpectrumPublisher::stop()
+{
+    if (fifos == nullptr)
+        return;
+
+    processor.releaseSpectrumFifos();
+    fifos = nullptr;
+    analysis.reset();
+    numBytes = 0;
+}
+
+void SpectrumPublisher::publish(double sampleRate)
+{
+    if (sampleRate <= 0.0)
+        return;
+
+    auto& generator = analysis->fftDataGenerator;
+    auto& fftData = analysis->fftData;
+
+    generator.produceFFTDataForRendering(analysis->stereoBuffer, -48.f);
+
+    if (! generator.getFFTData(fftData))
+        return;
+
+    const auto fftSize = generator.getFFTSize();
+    const auto numBins = fftSize / 2;
+    const auto binWidth = (float) (sampleRate / (double) fftSize);
+
+    for (int band = 0; band < SpectrumRegistry::NumBands; ++band)
+    {
+        auto lowFrequency = SpectrumRegistry::getBandFrequency((float) band - 0.5f);
+        auto highFrequency = SpectrumRegistry::getBandFrequency((float) band + 0.5f);
+
+        auto firstBin = juce::jlimit(1, numBins - 1, (int) std::floor(lowFrequency / binWidth));
+        auto lastBin = juce::jlimit(firstBin, numBins - 1, (int) std::ceil(highFrequency / binWidth));
+        auto level = -std::numeric_limits<float>::infinity();
+
+        for (int bin = firstBin; bin <= lastBin; ++bin)
+            level = juce::jmax(level, fftData[(size_t) bin], fftData[(size_t) (numBins + bin)]);
+
+        analysis->levels[(size_t) band] = level;
+    }
+
+    registry->publish(slot, analysis->levels);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "FFTDataGenerator.h"
+#include "PluginProcessor.h"
+#include "SpectrumRegistry.h"
+
+/**
+ Publishes an instance's output spectrum to the SpectrumRegistry, whether its editor is open or not,
+ so the overlay sees every track and not only the ones with a window showing.
+
+ Runs on a message thread timer owned by the processor. While nobody subscribes it only checks
+ the subscriber count, at IdleRateHz. Once someone does, it starts its own output capture, so the
+ editors' analyzer FIFOs keep all their buffers, and publishes a PublishRateHz FFT of it.
+ The capture and the FFT are freed again when the last subscriber goes.
+ */
+class SpectrumPublisher : private juce::Timer
+{
+public:
+    explicit SpectrumPublisher(ColinasEQAudioProcessor& processor);
+    ~SpectrumPublisher() override;
+
+    /** The slot this instance publishes to, or -1 if every slot was taken */
+    int getSlot() const { return slot; }
+
+    /** Bytes held for the capture's FFT, which only exists while publishing. Any thread */
+    size_t getNumBytes() const;
+
+    static constexpr int PublishRateHz = 10, IdleRateHz = 2;
+    static_assert(PublishRateHz >= AnalyzerMinReadRateHz, "the capture FIFOs are sized for reads at AnalyzerMinReadRateHz");
+
+private:
+    void timerCallback() override;
+
+    void start();
+    void stop();
+
+    /** Resamples the newest spectrum onto the registry's bands, taking the loudest bin of either channel in each */
+    void publish(double sampleRate);
+
+    ColinasEQAudioProcessor& processor;
+    juce::SharedResourcePointer<SpectrumRegistry> registry;
+    int slot = -1;
+
+    // Acquired from the processor while publishing
+    ColinasEQAudioProcessor::AnalyzerFifos* fifos = nullptr;
+
+    // Four times the editor's FFT size, which makes up for its finer decimated low band
+    struct Analysis
+    {
+        Analysis();
+
+        FFTDataGenerator<std::vector<float>> fftDataGenerator;
+        juce::AudioBuffer<float> stereoBuffer, leftBuffer, rightBuffer;
+        std::vector<float> fftData;
+        SpectrumRegistry::Levels levels;
+    };
+
+    std::unique_ptr<Analysis> analysis;
+    std::atomic<size_t> numBytes { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectrumPublisher)
+};
@@ -0,0 +1,75 @@
+#include "SpectrumRegistry.h"
+
+int SpectrumRegistry::claimSlot()
+{
+    for (int i = 0; i < MaxSlots; ++i)
+    {
+        auto& slot = slots[(size_t) i];
+        bool expected = false;
+
+        if (slot.claimed.compare_exchange_strong(expected, true))
+        {
+            /** Nothing from the previous owner counts as fresh */
+            slot.publishedAtMs.store(0, std::memory_order_relaxed);
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void SpectrumRegistry::releaseSlot(int slot)
+{
+    jassert(juce::isPositiveAndBelow(slot, MaxSlots));
+
+    slots[(size_t) slot].publishedAtMs.store(0, std::memory_order_relaxed);
+    slots[(size_t) slot].claimed.store(false);
+}
+
+void SpectrumRegistry::publish(int slot, const Levels& levels)
+{
+    jassert(juce::isPositiveAndBelow(slot, MaxSlots));
+
+    auto& s = slots[(size_t) slot];
+    auto sequence = s.sequence.load(std::memory_order_relaxed);
+
+    /** An odd sequence tells readers a write is in progress */
+    s.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (size_t i = 0; i < levels.size(); ++i)
+        s.levels[i].store(levels[i], std::memory_order_relaxed);
+
+    s.publishedAtMs.store(juce::Time::getMillisecondCounter(), std::memory_order_relaxed);
+    s.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool SpectrumRegistry::read(int slot, Levels& levels, juce::uint32 maxAgeMs) const
+{
+    jassert(juce::isPositiveAndBelow(slot, MaxSlots));
+
+    const auto& s = slots[(size_t) slot];
+
+    if (! s.claimed.load(std::memory_order_relaxed))
+        return false;
+
+    for (int attempt = 0; attempt < 3; ++attempt)
+    {
+        auto before = s.sequence.load(std::memory_order_acquire);
+
+        if ((before & 1) != 0)
+            continue;
+
+        for (size_t i = 0; i < levels.size(); ++i)
+            levels[i] = s.levels[i].load(std::memory_order_relaxed);
+
+        auto publishedAt = s.publishedAtMs.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (s.sequence.load(std::memory_order_relaxed) == before)
+            return publishedAt != 0 && juce::Time::getMillisecondCounter() - publishedAt <= maxAgeMs;
+    }
+
+    return false;
+}
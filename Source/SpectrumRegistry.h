@@ -0,0 +1,59 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <atomic>
+
+/**
+ Process-wide board where instances publish their latest output spectrum, so other
+ instances can overlay it and show where tracks mask each other.
+
+ Hold it through a juce::SharedResourcePointer<SpectrumRegistry>. Each publisher claims a
+ slot. Spectra are resampled to NumBands log-spaced bands between 20 Hz and 20 kHz, so
+ instances running different FFT sizes or sample rates can still be compared.
+
+ Every slot is a seqlock with a single writer. Publishing never waits or retries, and
+ publishers are expected to skip the work entirely while hasSubscribers() is false.
+ Readers retry a torn copy a few times and then give up until the next frame.
+ */
+class SpectrumRegistry
+{
+public:
+    static constexpr int MaxSlots = 32;
+    static constexpr int NumBands = 256;
+
+    // Level in dB of each band
+    using Levels = std::array<float, NumBands>;
+
+    static float getBandFrequency(float band)
+    {
+        return juce::mapToLog10(band / (float) (NumBands - 1), 20.f, 20000.f);
+    }
+
+    /** Returns a free slot for a new publisher, or -1 if they are all taken */
+    int claimSlot();
+    void releaseSlot(int slot);
+
+    void subscribe() { subscribers.fetch_add(1); }
+    void unsubscribe() { subscribers.fetch_sub(1); }
+    bool hasSubscribers() const { return subscribers.load(std::memory_order_relaxed) > 0; }
+
+    /** Wait-free. Only the slot's owner may publish to it */
+    void publish(int slot, const Levels& levels);
+
+    /** Copies a slot published to within the last maxAgeMs. Returns false for free, stale or torn slots */
+    bool read(int slot, Levels& levels, juce::uint32 maxAgeMs = 500) const;
+
+private:
+    struct Slot
+    {
+        std::atomic<bool> claimed { false };
+        std::atomic<juce::uint32> sequence { 0 }; // odd while a write is in progress
+        std::atomic<juce::uint32> publishedAtMs { 0 };
+        std::array<std::atomic<float>, NumBands> levels {};
+    };
+
+    std::array<Slot, MaxSlots> slots;
+    std::atomic<int> subscribers { 0 };
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Set to 1 in the project's preprocessor definitions to replace the input with a test tone
+#ifndef COLINASEQ_ENABLE_TEST_SIGNAL
+ #define COLINASEQ_ENABLE_TEST_SIGNAL 0
+#endif
+
+/**
+ Sine tone used for testing the spectrum analyzer with sound waves.
+ When processed it replaces whatever is in the block, so it must run before the filter chains.
+ */
+struct TestSignal
+{
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        osc.initialise([](float x) { return std::sin(x); });
+        osc.prepare(spec);
+        osc.setFrequency(frequency);
+    }
+
+    void setFrequency(float newFrequency)
+    {
+        frequency = newFrequency;
+        osc.setFrequency(frequency);
+    }
+
+    void process(juce::dsp::AudioBlock<float>& block)
+    {
+        block.clear();
+
+        juce::dsp::ProcessContextReplacing<float> context(block);
+        osc.process(context);
+    }
+
+private:
+    juce::dsp::Oscillator<float> osc;
+    float frequency = 5000.f;
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <vector>
+
+/**
+ Draws traces given as one y position per column straight into an ARGB image.
+
+ Each column is a vertical span covering the segment to the next column plus the line
+ thickness, with fractional coverage at both ends for antialiasing. That is all the
+ mostly flat spectrum and response traces need, and it avoids building and stroking a Path.
+ A vertical span thins a line as it gets steeper, down to one pixel across, so segments
+ steeper than MaxSpanSlope are collected into a Path and stroked instead.
+ The renderer remembers what it touched, so the next frame only clears that area.
+ */
+class TraceRenderer
+{
+public:
+    /** Clears what the previous frame drew */
+    void beginFrame(juce::Image& image)
+    {
+        if (! dirtyArea.isEmpty())
+            image.clear(dirtyArea);
+
+        dirtyArea = {};
+    }
+
+    /** Forget the dirty area, e.g. after the image was recreated */
+    void reset() { dirtyArea = {}; }
+
+    juce::Rectangle<int> getDirtyArea() const { return dirtyArea; }
+
+    /**
+     Draws ys, given in logical pixels relative to 'origin', into an image holding
+     logical pixels at 'scale'. Columns that are NaN or infinite are skipped.
+     With fillBelow the area under the trace is filled with a faint version of the colour.
+     */
+    void drawTrace(juce::Image& image,
+                   const std::vector<float>& ys,
+                   float scale,
+                   juce::Point<float> origin,
+                   float thickness,
+                   juce::Colour colour,
+                   bool fillBelow = false)
+    {
+        jassert(image.getFormat() == juce::Image::ARGB);
+
+        if (ys.empty())
+            return;
+
+        steepSegments.clear();
+        const auto halfThickness = thickness * scale * 0.5f;
+
+        {
+            juce::Image::BitmapData data(image, juce::Image::BitmapData::readWrite);
+
+            const auto lastIndex = (float) ys.size() - 1.f;
+            const auto lineColour = colour.getPixelARGB();
+            const auto fillColour = colour.withMultipliedAlpha(0.2f).getPixelARGB();
+
+            /** y in image pixels at the left edge of image column x */
+            auto yAtColumn = [&](int x)
+            {
+                auto index = juce::jlimit(0.f, lastIndex, (float) x / scale - origin.x);
+                auto i0 = (size_t) index;
+                auto i1 = juce::jmin(i0 + 1, ys.size() - 1);
+                auto frac = index - (float) i0;
+
+                return (ys[i0] + (ys[i1] - ys[i0]) * frac + origin.y) * scale;
+            };
+
+            const auto firstColumn = juce::jmax(0, juce::roundToInt(origin.x * scale));
+            const auto endColumn = juce::jmin(data.width, juce::roundToInt((origin.x + (float) ys.size()) * scale));
+
+            int minRow = data.height, maxRow = 0;
+            auto current = yAtColumn(firstColumn);
+
+            for (int x = firstColumn; x < endColumn; ++x)
+            {
+                auto next = yAtColumn(x + 1);
+
+                if (std::isfinite(current) && std::isfinite(next))
+                {
+                    auto top = juce::jmax(0.f, juce::jmin(current, next) - halfThickness);
+                    auto bottom = juce::jmin((float) data.height, juce::jmax(current, next) + halfThickness);
+
+                    if (std::abs(next - current) > MaxSpanSlope)
+                    {
+                        /** Consecutive steep columns join into one sub-path, so the stroke's joints line up */
+                        if (steepSegments.isEmpty() || steepSegments.getCurrentPosition() != juce::Point<float>((float) x, current))
+                            steepSegments.startNewSubPath((float) x, current);
+
+                        steepSegments.lineTo((float) (x + 1), next);
+                    }
+                    else if (top < bottom)
+                    {
+                        fillSpan(data, x, top, bottom, lineColour);
+                        minRow = juce::jmin(minRow, (int) top);
+                        maxRow = juce::jmax(maxRow, (int) std::ceil(bottom));
+                    }
+
+                    if (fillBelow && bottom < (float) data.height)
+                    {
+                        fillSpan(data, x, juce::jmax(0.f, bottom), (float) data.height, fillColour);
+                        minRow = juce::jmin(minRow, (int) juce::jmax(0.f, bottom));
+                        maxRow = data.height;
+                    }
+                }
+
+                current = next;
+            }
+
+            if (minRow < maxRow)
+                dirtyArea = dirtyArea.getUnion({ firstColumn, minRow, endColumn - firstColumn, maxRow - minRow });
+        }
+
+        /** Drawn once the bitmap data above has been released */
+        if (! steepSegments.isEmpty())
+        {
+            juce::Graphics g(image);
+            g.setColour(colour);
+            g.strokePath(steepSegments, juce::PathStrokeType(thickness * scale, juce::PathStrokeType::curved, juce::PathStrokeType::rounded));
+
+            dirtyArea = dirtyArea.getUnion(steepSegments.getBounds().expanded(halfThickness + 1.f).getSmallestIntegerContainer()
+                                                                   .getIntersection(image.getBounds()));
+        }
+    }
+
+private:
+    /** Blends one column from top to bottom (in pixels), with partial coverage at both ends */
+    static void fillSpan(juce::Image::BitmapData& data, int x, float top, float bottom, juce::PixelARGB colour)
+    {
+        const auto firstRow = (int) top;
+        const auto endRow = juce::jmin(data.height, (int) std::ceil(bottom));
+
+        auto* pixel = data.getPixelPointer(x, firstRow);
+
+        for (int row = firstRow; row < endRow; ++row, pixel += data.lineStride)
+        {
+            auto coverage = juce::jmin(bottom, (float) row + 1.f) - juce::jmax(top, (float) row);
+            auto* argb = reinterpret_cast<juce::PixelARGB*>(pixel);
+
+            if (coverage >= 1.f)
+                argb->blend(colour);
+            else
+                argb->blend(colour, (juce::uint32) juce::roundToInt(coverage * 255.f));
+        }
+    }
+
+    // Beyond one pixel per column a span keeps less than 70% of the thickness across the line
+    static constexpr float MaxSpanSlope = 1.f;
+    juce::Path steepSegments;
+
+    juce::Rectangle<int> dirtyArea;
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <vector>
+
+/**
+ Scrolling spectrogram kept in a circular image.
+
+ Every analyzer frame becomes one column, written at a moving write position, so nothing
+ is ever shifted. Rows map to FFT bins through a table built in prepare(), and levels map
+ to colours through a lookup table, so a frame costs one table lookup per row.
+ Frequency runs from 20 Hz at the bottom to 20 kHz at the top, time from left to right.
+ */
+class Waterfall
+{
+public:
+    Waterfall()
+    {
+        juce::ColourGradient gradient(juce::Colours::black, 0.f, 0.f, juce::Colours::white, 1.f, 0.f, false);
+        gradient.addColour(0.3, juce::Colours::darkblue);
+        gradient.addColour(0.55, juce::Colours::purple);
+        gradient.addColour(0.75, juce::Colours::orange);
+        gradient.addColour(0.9, juce::Colours::yellow);
+
+        for (size_t i = 0; i < colourTable.size(); ++i)
+            colourTable[i] = gradient.getColourAtPosition((double) i / (double) (colourTable.size() - 1)).getPixelARGB();
+    }
+
+    /** Sizes are in physical pixels. History is cleared whenever anything changes */
+    void prepare(int width, int height, int fftSize, double sampleRate)
+    {
+        if (image.isValid() && image.getWidth() == width && image.getHeight() == height
+            && preparedFFTSize == fftSize && preparedSampleRate == sampleRate)
+            return;
+
+        preparedFFTSize = fftSize;
+        preparedSampleRate = sampleRate;
+
+        /** ARGB is 4-byte PixelARGB on every platform, where the layout of a native RGB image varies */
+        image = juce::Image(juce::Image::ARGB, juce::jmax(1, width), juce::jmax(1, height), false);
+        image.clear(image.getBounds(), juce::Colours::black);
+        writeColumn = 0;
+        
+        /** A cleared image is black, which is colour index 0 */
+        lastColumn.assign((size_t) image.getHeight(), 0);
+        unchangedColumns = 0;
+
+        const auto numBins = fftSize / 2;
+        const auto binWidth = sampleRate / (double) fftSize;
+
+        rowToBin.resize((size_t) image.getHeight());
+
+        for (int row = 0; row < image.getHeight(); ++row)
+        {
+            auto normalizedY = 1.0 - ((double) row + 0.5) / (double) image.getHeight();
+            auto frequency = juce::mapToLog10(normalizedY, 20.0, 20000.0);
+            rowToBin[(size_t) row] = juce::jlimit(1, numBins - 1, juce::roundToInt(frequency / binWidth));
+        }
+    }
+
+    bool isPrepared() const { return image.isValid(); }
+
+    /** The image is 4 bytes per pixel */
+    size_t getNumBytes() const
+    {
+        return (size_t) (image.getWidth() * image.getHeight()) * 4 + rowToBin.capacity() * sizeof(int) + lastColumn.capacity();
+    }
+
+    /**
+     Writes one frame from the left and right bins in dB, showing the louder channel.
+     Returns false once the picture holds still: every column on screen the same as the new one
+     */
+    bool pushFrame(const float* leftDecibels, const float* rightDecibels, float negativeInfinity)
+    {
+        if (! image.isValid())
+            return false;
+
+        writeColumn = (writeColumn + 1) % image.getWidth();
+
+        juce::Image::BitmapData data(image, writeColumn, 0, 1, image.getHeight(), juce::Image::BitmapData::writeOnly);
+        jassert(data.pixelStride == (int) sizeof(juce::PixelARGB));
+        auto* pixel = data.getPixelPointer(0, 0);
+        const auto lastIndex = (int) colourTable.size() - 1;
+        bool columnChanged = false;
+
+        for (int row = 0; row < data.height; ++row, pixel += data.lineStride)
+        {
+            auto bin = (size_t) rowToBin[(size_t) row];
+            auto level = juce::jmax(leftDecibels[bin], rightDecibels[bin]);
+            auto index = juce::jlimit(0, lastIndex, (int) juce::jmap(level, negativeInfinity, 0.f, 0.f, (float) lastIndex));
+
+            *reinterpret_cast<juce::PixelARGB*>(pixel) = colourTable[(size_t) index];
+            
+            if (lastColumn[(size_t) row] != (juce::uint8) index)
+            {
+                lastColumn[(size_t) row] = (juce::uint8) index;
+                columnChanged = true;
+            }
+        }
+        
+        unchangedColumns = columnChanged ? 0 : juce::jmin(unchangedColumns + 1, image.getWidth());
+        return unchangedColumns < image.getWidth();
+    }
+
+    /** Draws the history into 'area' with the newest column at the right edge. scale is the image's pixels per logical pixel */
+    void draw(juce::Graphics& g, juce::Rectangle<int> area, float scale) const
+    {
+        if (! image.isValid())
+            return;
+
+        juce::Graphics::ScopedSaveState state(g);
+        g.reduceClipRegion(area);
+
+        /** Two 1:1 blits of the same image either side of the write position */
+        const auto oldestColumn = (float) (writeColumn + 1);
+        const auto toLogical = juce::AffineTransform::scale(1.f / scale);
+
+        g.drawImageTransformed(image, toLogical.translated((float) area.getX() - oldestColumn / scale, (float) area.getY()));
+        g.drawImageTransformed(image, toLogical.translated((float) area.getX() + ((float) image.getWidth() - oldestColumn) / scale,
+                                                           (float) area.getY()));
+    }
+
+private:
+    juce::Image image;
+    int writeColumn = 0;
+
+    int preparedFFTSize = 0;
+    double preparedSampleRate = 0.0;
+
+    std::vector<int> rowToBin;
+    
+    // Colour indices of the newest column, and how many pushes in a row repeated it
+    std::vector<juce::uint8> lastColumn;
+    int unchangedColumns = 0;
+    std::array<juce::PixelARGB, 256> colourTable;
+};